@@ -0,0 +1,39 @@
+// Replaces the global operator new with one that counts its calls. Linked
+// into dpor_profile only, where the exploration reports the allocations it
+// made as "explore_heap_allocations" in the PROFILE line.
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+
+static atomic<long> g_heap_allocations(0);
+
+long
+profile_heap_allocations()
+{
+  return g_heap_allocations.load(memory_order_relaxed);
+}
+
+void*
+operator new(size_t size)
+{
+  g_heap_allocations.fetch_add(1, memory_order_relaxed);
+  void* ret = malloc(size ? size : 1);
+  if (ret == NULL) {
+    throw bad_alloc();
+  }
+  return ret;
+}
+
+void
+operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void
+operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
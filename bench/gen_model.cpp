@@ -0,0 +1,103 @@
+// Generates a synthetic concurrent program in the input format of dpor.
+//
+// Usage: gen_model <procs> <instructions> <vars> <locks> [seed]
+//                  [--contention P] [--overlap P] [--po-density P]
+//
+// Every process gets <instructions> instructions. With <locks> > 0 an
+// instruction outside a critical section starts one (acquire of a random
+// lock) with probability --contention percent (default 25). Variable
+// accesses go to the <vars> shared variables with probability --overlap
+// percent (default 100), and to variables private to the process
+// otherwise. Each pair of consecutive instructions of a process is listed
+// in PROGRAM_ORDER with probability --po-density percent (default 100).
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+using namespace std;
+
+static int
+percent_option(char const* value)
+{
+  return min(max(atoi(value), 0), 100);
+}
+
+int
+main(int argc, char **argv)
+{
+  vector<char const*> args;
+  int contention = 25, overlap = 100, po_density = 100;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--contention" && i + 1 < argc) {
+      contention = percent_option(argv[++i]);
+    } else if (arg == "--overlap" && i + 1 < argc) {
+      overlap = percent_option(argv[++i]);
+    } else if (arg == "--po-density" && i + 1 < argc) {
+      po_density = percent_option(argv[++i]);
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  if (args.size() < 4) {
+    cerr << "Usage: " << argv[0] << " <procs> <instructions> <vars> <locks> [seed]"
+      << " [--contention P] [--overlap P] [--po-density P]" << endl;
+    return 1;
+  }
+  int procs = atoi(args[0]);
+  int instructions = atoi(args[1]);
+  int vars = max(atoi(args[2]), 1);
+  int locks = atoi(args[3]);
+  unsigned seed = args.size() > 4 ? atoi(args[4]) : 1;
+  mt19937 rng(seed);
+
+  vector<pair<string, string>> program_order;
+  for (int p = 0; p < procs; ++p) {
+    auto variable = [&]() {
+      if ((int) (rng() % 100) < overlap) {
+        return "v" + to_string(rng() % vars);
+      }
+      return "p" + to_string(p) + "_v" + to_string(rng() % vars);
+    };
+
+    cout << "P" << p << " {\n";
+    int held = -1;
+    string prev;
+    for (int i = 0; i < instructions; ++i) {
+      string label = "t" + to_string(p) + "_" + to_string(i);
+      cout << "  " << label << ": ";
+      if (held >= 0 && (rng() % 8 < 3 || i == instructions - 1)) {
+        cout << "release(m" << held << ")";
+        held = -1;
+      } else if (held < 0 && locks > 0 && (int) (rng() % 100) < contention && i < instructions - 1) {
+        held = rng() % locks;
+        cout << "acquire(m" << held << ")";
+      } else if (rng() % 2) {
+        // constants start at 1 in the input grammar
+        cout << variable() << " := " << 1 + rng() % 9;
+      } else {
+        string lhs = variable();
+        cout << lhs << " := " << variable();
+      }
+      cout << "\n";
+      if (i > 0 && (int) (rng() % 100) < po_density) {
+        program_order.push_back(make_pair(prev, label));
+      }
+      prev = label;
+    }
+    cout << "}\n\n";
+  }
+
+  cout << "PROGRAM_ORDER: {";
+  for (size_t i = 0; i < program_order.size(); ++i) {
+    if (i != 0) {
+      cout << ", ";
+    }
+    cout << "(" << program_order[i].first << ", " << program_order[i].second << ")";
+  }
+  cout << "}\n";
+
+  return 0;
+}
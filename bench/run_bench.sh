@@ -0,0 +1,59 @@
+#!/bin/sh
+# Benchmark suite for the DPOR engine.
+# Runs ./dpor over the models in input/ and a grid of generated models,
+# and prints one record per run with the time of every phase and the
+# exploration throughput. FORMAT=json prints one JSON object per line,
+# the default is CSV. THREADS (default 1) is passed to --threads and
+# BUILD (default the git revision) tags the records, so results of
+# different builds can be collected in one file and compared.
+set -e
+
+FORMAT=${FORMAT:-csv}
+THREADS=${THREADS:-1}
+BUILD=${BUILD:-$(git rev-parse --short HEAD 2>/dev/null || echo unknown)}
+MODELS_DIR=$(mktemp -d)
+trap 'rm -rf "$MODELS_DIR"' EXIT
+
+# name procs instructions vars locks seed [options]
+gen() {
+  name=$1
+  shift
+  ./gen_model "$@" > "$MODELS_DIR/$name.txt"
+}
+gen small_3x8 3 8 4 1 1
+gen base_4x6 4 6 4 2 2
+gen base_5x5 5 5 6 2 3
+gen contended_4x8 4 8 4 1 4 --contention 60
+gen uncontended_4x8 4 8 4 2 4 --contention 0
+gen disjoint_5x6 5 6 4 2 5 --overlap 20
+gen sparse_po_4x6 4 6 4 2 6 --po-density 30
+gen large_6x5 6 5 6 2 4
+
+field() {
+  echo "$1" | sed -n "s/^$2 = \([0-9]*\).*/\1/p"
+}
+
+if [ "$FORMAT" = csv ]; then
+  echo "build,model,threads,parse_us,dependancy_us,explore_us,output_us,states,transitions,executions,states_per_sec,transitions_per_sec"
+fi
+for model in input/*.txt "$MODELS_DIR"/*.txt; do
+  out=$(./dpor --threads "$THREADS" "$model" "$MODELS_DIR/out.dot")
+  name=$(basename "$model" .txt)
+  parse=$(field "$out" PHASE_PARSE_US)
+  dependancy=$(field "$out" PHASE_DEPENDANCY_US)
+  explore=$(field "$out" PHASE_EXPLORE_US)
+  output=$(field "$out" PHASE_OUTPUT_US)
+  states=$(field "$out" NUM_STATES)
+  transitions=$(field "$out" NUM_TRANSITIONS)
+  executions=$(field "$out" NUM_EXECUTIONS)
+  states_rate=$(field "$out" STATES_PER_SEC)
+  transitions_rate=$(field "$out" TRANSITIONS_PER_SEC)
+  if [ "$FORMAT" = json ]; then
+    echo "{\"build\": \"$BUILD\", \"model\": \"$name\", \"threads\": $THREADS," \
+      "\"parse_us\": $parse, \"dependancy_us\": $dependancy, \"explore_us\": $explore, \"output_us\": $output," \
+      "\"states\": $states, \"transitions\": $transitions, \"executions\": $executions," \
+      "\"states_per_sec\": $states_rate, \"transitions_per_sec\": $transitions_rate}"
+  else
+    echo "$BUILD,$name,$THREADS,$parse,$dependancy,$explore,$output,$states,$transitions,$executions,$states_rate,$transitions_rate"
+  fi
+done
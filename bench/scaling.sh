@@ -0,0 +1,29 @@
+#!/bin/sh
+# Thread scaling benchmark for the parallel exploration engine.
+# Runs ./dpor with 1, 2, 4, ... threads (up to $MAX_THREADS, default the
+# number of cores) over the models in input/ and a few generated models,
+# and prints one CSV line per run.
+set -e
+
+MAX_THREADS=${MAX_THREADS:-$(nproc)}
+MODELS_DIR=$(mktemp -d)
+trap 'rm -rf "$MODELS_DIR"' EXIT
+
+# procs instructions vars locks seed
+./gen_model 3 8 4 1 1 > "$MODELS_DIR/gen_3x8.txt"
+./gen_model 4 6 4 2 2 > "$MODELS_DIR/gen_4x6.txt"
+./gen_model 5 5 6 2 3 > "$MODELS_DIR/gen_5x5.txt"
+
+echo "model,threads,time_us,states,transitions,executions"
+for model in input/*.txt "$MODELS_DIR"/*.txt; do
+  threads=1
+  while [ "$threads" -le "$MAX_THREADS" ]; do
+    out=$(./dpor --threads "$threads" "$model" "$MODELS_DIR/out.dot")
+    time=$(echo "$out" | sed -n 's/^Time difference = \([0-9]*\).*/\1/p')
+    states=$(echo "$out" | sed -n 's/^NUM_STATES = //p')
+    transitions=$(echo "$out" | sed -n 's/^NUM_TRANSITIONS = //p')
+    executions=$(echo "$out" | sed -n 's/^NUM_EXECUTIONS = //p')
+    echo "$(basename "$model" .txt),$threads,$time,$states,$transitions,$executions"
+    threads=$((threads * 2))
+  done
+done
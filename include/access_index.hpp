@@ -0,0 +1,93 @@
+#ifndef ACCESS_INDEX_HPP
+#define ACCESS_INDEX_HPP
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+using namespace std;
+
+// Stack positions of the last write and read of every shared variable and
+// the last acquire of every lock, per process, and of every instruction on
+// the stack. Kept in step with the transition stack, so that the last
+// transition of a process dependant with an instruction is found without
+// scanning the stack. Every push logs the entries it overwrites, and pop()
+// restores them.
+class access_index
+{
+private:
+  int m_num_procs;
+  // [var * m_num_procs + proc]
+  vector<int> m_last_write;
+  vector<int> m_last_read;
+  // [lock * m_num_procs + proc]
+  vector<int> m_last_acquire;
+  // [instruction id]
+  vector<int> m_position;
+  // (entry, previous value) of every update, and the log size before
+  // each pushed transition
+  vector<pair<int*, int>> m_log;
+  vector<int> m_marks;
+
+  void update(int& entry, int value)
+  {
+    m_log.push_back(make_pair(&entry, entry));
+    entry = value;
+  }
+
+public:
+  access_index() : m_num_procs(0) {}
+
+  access_index(int num_vars, int num_locks, int num_instructions, int num_procs)
+    : m_num_procs(num_procs),
+      m_last_write((size_t) num_vars * num_procs, -1),
+      m_last_read((size_t) num_vars * num_procs, -1),
+      m_last_acquire((size_t) num_locks * num_procs, -1),
+      m_position(num_instructions, -1)
+  { }
+
+  // Records the transition at stack position pos, of process proc
+  // executing instruction ins, with the variables and lock it accesses
+  // (-1 if none)
+  void push(int pos, int proc, int ins, int written, int read, int acquired)
+  {
+    m_marks.push_back(m_log.size());
+    if (written >= 0) {
+      update(m_last_write[written * m_num_procs + proc], pos);
+    }
+    if (read >= 0) {
+      update(m_last_read[read * m_num_procs + proc], pos);
+    }
+    if (acquired >= 0) {
+      update(m_last_acquire[acquired * m_num_procs + proc], pos);
+    }
+    update(m_position[ins], pos);
+  }
+
+  // Undoes the last push()
+  void pop()
+  {
+    int mark = m_marks.back();
+    m_marks.pop_back();
+    while ((int) m_log.size() > mark) {
+      *m_log.back().first = m_log.back().second;
+      m_log.pop_back();
+    }
+  }
+
+  int size() const { return m_marks.size(); }
+
+  void clear()
+  {
+    while (!m_marks.empty()) {
+      pop();
+    }
+  }
+
+  int last_write(int var, int proc) const { return var < 0 ? -1 : m_last_write[var * m_num_procs + proc]; }
+  int last_read(int var, int proc) const { return var < 0 ? -1 : m_last_read[var * m_num_procs + proc]; }
+  int last_acquire(int lock, int proc) const { return lock < 0 ? -1 : m_last_acquire[lock * m_num_procs + proc]; }
+  int position(int ins) const { return m_position[ins]; }
+};
+
+#endif
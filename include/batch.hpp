@@ -0,0 +1,47 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <string>
+#include <vector>
+#include "dpor.hpp"
+
+using namespace std;
+
+// Parses the model in filename and interns its symbols. Safe to call from
+// several threads at once. Throws a string literal if the file cannot be
+// read or parsed; the caller owns the returned program.
+concurrent_procs* parse_model(string const& filename);
+
+// Outcome of exploring one model of a batch
+struct batch_result
+{
+  string m_model;
+  // empty if the model was explored, otherwise what went wrong
+  string m_error;
+  long m_parse_us;
+  long m_dependancy_us;
+  long m_explore_us;
+  long m_states;
+  long m_transitions;
+  long m_executions;
+
+  batch_result()
+    : m_parse_us(0), m_dependancy_us(0), m_explore_us(0),
+      m_states(0), m_transitions(0), m_executions(0)
+  { }
+};
+
+// Model files of a batch: the *.txt files of a directory in name order, or
+// the lines of a manifest file. Manifest lines that are empty or start
+// with '#' are skipped, relative paths are taken from the manifest's
+// directory.
+vector<string> list_batch_models(string const& source);
+
+// Explores every model on jobs threads with options, which must not write
+// a graph, and writes one CSV record per model to results_file in the
+// order of the models. A model that fails is reported in its record and
+// does not stop the others. Returns the number of failed models.
+int run_batch(vector<string> const& models, string const& results_file, int jobs,
+  dpor_options const& options);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef BIT_MATRIX_HPP
+#define BIT_MATRIX_HPP
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+// Dense n x n boolean matrix, one bit per entry, rows padded to 64 bits
+class bit_matrix
+{
+private:
+  int m_n;
+  int m_words_per_row;
+  vector<uint64_t> m_bits;
+
+public:
+  bit_matrix() : m_n(0), m_words_per_row(0)
+  { }
+
+  bit_matrix(int n)
+    : m_n(n), m_words_per_row((n + 63) / 64),
+      m_bits((size_t) n * ((n + 63) / 64), 0)
+  { }
+
+  int size() const { return m_n; }
+
+  void set(int i, int j)
+  {
+    m_bits[(size_t) i * m_words_per_row + (j >> 6)] |= (uint64_t) 1 << (j & 63);
+  }
+
+  bool test(int i, int j) const
+  {
+    return (m_bits[(size_t) i * m_words_per_row + (j >> 6)] >> (j & 63)) & 1;
+  }
+};
+
+#endif
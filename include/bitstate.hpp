@@ -0,0 +1,90 @@
+#ifndef BITSTATE_HPP
+#define BITSTATE_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <sstream>
+#include "util.hpp"
+
+using namespace std;
+
+// Visited set of bitstate hashing: a key (the hash of a state and a
+// transition taken from it) is only remembered by k bits of a fixed bit
+// array, a Bloom filter, chosen by double hashing. A key whose k bits are
+// all set is taken as seen, which may be wrong: part of the state space
+// may then be missed, but nothing is explored twice.
+class bitstate_table
+{
+private:
+  vector<uint64_t> m_words;
+  uint64_t m_bits;
+  int m_hashes;
+  long m_bits_set;
+  long m_stored;
+  long m_hits;
+  // sum over the stored keys of the chance that their lookup would have
+  // been a false hit, given the fill ratio at the time
+  double m_expected_false_hits;
+
+public:
+  bitstate_table(size_t bytes, int hashes)
+    : m_words(max(bytes / 8, (size_t) 1), 0), m_bits(m_words.size() * 64),
+      m_hashes(hashes), m_bits_set(0), m_stored(0), m_hits(0),
+      m_expected_false_hits(0)
+  { }
+
+  // Sets the bits of key h and returns whether they were all set already
+  bool test_and_set(size_t h)
+  {
+    uint64_t h1 = hash_mix(h);
+    uint64_t h2 = hash_mix(h ^ 0x9e3779b97f4a7c15ULL) | 1;
+    int fresh = 0;
+    for (int i = 0; i < m_hashes; ++i) {
+      uint64_t bit = (h1 + i * h2) % m_bits;
+      uint64_t mask = (uint64_t) 1 << (bit & 63);
+      if (!(m_words[bit >> 6] & mask)) {
+        m_words[bit >> 6] |= mask;
+        fresh++;
+      }
+    }
+    if (!fresh) {
+      m_hits++;
+      return true;
+    }
+    m_expected_false_hits += false_hit_probability();
+    m_bits_set += fresh;
+    m_stored++;
+    return false;
+  }
+
+  double fill_ratio() const { return (double) m_bits_set / m_bits; }
+
+  // Chance that a key not seen yet is taken as seen
+  double false_hit_probability() const
+  {
+    double p = 1;
+    for (int i = 0; i < m_hashes; ++i) {
+      p *= fill_ratio();
+    }
+    return p;
+  }
+
+  size_t bytes() const { return m_words.size() * sizeof(uint64_t); }
+
+  string dump_stats() const
+  {
+    stringstream ss;
+    ss << "BITSTATE_BITS = " << m_bits << "\n";
+    ss << "BITSTATE_HASHES = " << m_hashes << "\n";
+    ss << "BITSTATE_STORED = " << m_stored << "\n";
+    ss << "BITSTATE_HITS = " << m_hits << "\n";
+    ss << "BITSTATE_FILL_RATIO = " << fill_ratio() << "\n";
+    ss << "BITSTATE_FALSE_HIT_PROBABILITY = " << false_hit_probability() << "\n";
+    ss << "BITSTATE_EXPECTED_FALSE_HITS = " << m_expected_false_hits << "\n";
+    ss << "BITSTATE_MISS_PROBABILITY = " << (m_stored ? m_expected_false_hits / (m_stored + m_expected_false_hits) : 0.0) << "\n";
+    return ss.str();
+  }
+};
+
+#endif
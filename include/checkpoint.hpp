@@ -0,0 +1,190 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "process_set.hpp"
+
+using namespace std;
+
+class state;
+class concurrent_procs;
+
+// Layout of a checkpoint file written with --checkpoint. All integers are
+// in host byte order:
+//
+//   checkpoint_file_header
+//   store:  num_states records of width int32 slots, in store order
+//   sets:   for every stored state its backtrack, done and sleep sets,
+//           set_words uint64 words each
+//   search: search_bytes bytes written by dpor::take_checkpoint, holding
+//           the counters, the stack, the frames and the clock vectors
+//
+// A checkpoint is written to a temporary file which then replaces the
+// previous one, so a crash while writing leaves the last one intact.
+
+static const char checkpoint_file_magic[8] = { 'D', 'P', 'O', 'R', 'C', 'K', 'P', 'T' };
+static const uint32_t checkpoint_file_version = 1;
+
+// m_flags bits, a checkpoint is only resumed with the same ones
+static const uint32_t checkpoint_stateless = 1;
+static const uint32_t checkpoint_symmetry = 2;
+
+struct checkpoint_file_header
+{
+  char m_magic[8];
+  uint32_t m_version;
+  uint32_t m_flags;
+  uint64_t m_fingerprint;
+  uint32_t m_width;
+  uint32_t m_set_words;
+  uint64_t m_num_states;
+  uint64_t m_search_bytes;
+};
+
+// Identifies the model a checkpoint was taken of: its symbols, instruction
+// table and dependancy relation
+uint64_t checkpoint_fingerprint(concurrent_procs const& program);
+
+// Byte buffer the search section is serialized into and read back from
+class checkpoint_buffer
+{
+private:
+  vector<char> m_data;
+  size_t m_read;
+
+public:
+  checkpoint_buffer() : m_read(0)
+  { }
+
+  template <typename T>
+  void put(T const& v) { put_array(&v, 1); }
+
+  template <typename T>
+  void put_array(T const* v, size_t n)
+  {
+    char const* p = (char const*) v;
+    m_data.insert(m_data.end(), p, p + n * sizeof(T));
+  }
+
+  template <typename T>
+  T get()
+  {
+    T v;
+    get_array(&v, 1);
+    return v;
+  }
+
+  template <typename T>
+  void get_array(T* v, size_t n)
+  {
+    if (n * sizeof(T) > m_data.size() - m_read) {
+      throw "The checkpoint is truncated";
+    }
+    memcpy(v, m_data.data() + m_read, n * sizeof(T));
+    m_read += n * sizeof(T);
+  }
+
+  void put_set(process_set const& s, int words)
+  {
+    for (int i = 0; i < words; ++i) {
+      put<uint64_t>(s.get_word(i));
+    }
+  }
+
+  process_set get_set(int words)
+  {
+    process_set ret;
+    for (int i = 0; i < words; ++i) {
+      ret.set_word(i, get<uint64_t>());
+    }
+    return ret;
+  }
+
+  vector<char>& data() { return m_data; }
+  size_t size() const { return m_data.size(); }
+};
+
+// What the exploration thread hands to the writer at a checkpoint. Slots
+// never change once a state is stored, so states are passed by pointer,
+// while the sets that may have changed since the last checkpoint are
+// copied.
+struct checkpoint_delta
+{
+  // store positions of the states that may have changed, the states, and
+  // their backtrack, done and sleep sets as set_words words each
+  vector<int> m_dirty;
+  vector<state const*> m_dirty_states;
+  vector<uint64_t> m_dirty_words;
+  checkpoint_buffer m_search;
+};
+
+// Writes checkpoints on a thread of its own. Every interval the thread
+// asks for a checkpoint through due(); the exploration thread captures a
+// delta where its stack is consistent and submits it, and the writer
+// merges it into its own image of the store and writes the file. The
+// exploration thread only pays for the capture.
+class checkpoint_writer
+{
+private:
+  string m_file;
+  long m_interval_ms;
+  checkpoint_file_header m_header;
+  // image of the store: the stored states and their sets
+  vector<state const*> m_states;
+  vector<uint64_t> m_sets;
+  checkpoint_buffer m_search;
+
+  atomic<bool> m_due;
+  std::mutex m_lock;
+  condition_variable m_wake;
+  unique_ptr<checkpoint_delta> m_pending;
+  bool m_stopping;
+  thread m_thread;
+
+  long m_written;
+  long m_failed;
+  long m_bytes;
+  // time the exploration thread spent capturing deltas
+  long m_max_capture_us;
+  long m_total_capture_us;
+
+  void run();
+  void merge(checkpoint_delta& delta);
+  bool write_file();
+
+public:
+  checkpoint_writer(string const& file, double interval_seconds, uint32_t flags,
+    uint64_t fingerprint, int width, int set_words);
+  ~checkpoint_writer();
+
+  checkpoint_writer(checkpoint_writer const&) = delete;
+  checkpoint_writer& operator=(checkpoint_writer const&) = delete;
+
+  // Seeds the image with a store restored from a checkpoint, before the
+  // first delta is submitted
+  void restore(vector<state*> const& states, vector<uint64_t> const& sets);
+  // Whether the writer waits for a delta
+  bool due() const { return m_due.load(memory_order_relaxed); }
+  // Hands a delta over to the writer thread, capture_us is the time spent
+  // capturing it
+  void submit(unique_ptr<checkpoint_delta> delta, long capture_us);
+  // Writes the submitted delta, if any, and stops the writer thread
+  void finish();
+
+  string dump_stats() const;
+};
+
+// Reads the checkpoint in file. Throws a string literal if it cannot be
+// read or is not a checkpoint.
+void read_checkpoint(string const& file, checkpoint_file_header& header,
+  vector<int>& slots, vector<uint64_t>& sets, checkpoint_buffer& search);
+
+#endif
@@ -2,8 +2,27 @@
 #define DPOR_HPP
 
 #include "program.hpp"
+#include "state_store.hpp"
+#include "state_arena.hpp"
+#include "process_set.hpp"
+#include "work_deque.hpp"
+#include "graph_writer.hpp"
+#include "profile.hpp"
+#include "wakeup_tree.hpp"
+#include "bit_matrix.hpp"
+#include "access_index.hpp"
+#include "symmetry.hpp"
+#include "checkpoint.hpp"
+#include "spill_table.hpp"
+#include "bitstate.hpp"
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <atomic>
 #include <assert.h>
+#include <string.h>
 #include <fstream>
+#include <iomanip>
 
 using namespace std;
 
@@ -17,71 +36,115 @@ string enum_mutex_to_string(mutex_status m);
 class state
 {
 private:
-  label m_label;
-  // var --> value mapping
-  unordered_map<variable, int> m_shared_state;
-  // lock --> (status, owner) mapping
-  unordered_map<variable, pair<mutex_status, label>> m_mutex_state;
-  // process_id --> pc (to be executed) mapping
-  unordered_map<label, int> m_loc_state;
-
-  unordered_set<process*> m_backtrack_set;
-  unordered_set<process*> m_done_set;
-  unordered_set<process*> m_sleep_set;
+  int m_label;
+  symbol_table const* m_symbols;
+  // flat [ shared values | mutex owners | pcs ] array, see symbol_table.
+  // The storage is owned by the state_arena that allocated this state.
+  int* m_slots;
+  // Zobrist hash of the slots, kept up to date by set_slot()
+  size_t m_hash;
+
+  // sets of process ids, see symbol_table. The done set holds the
+  // processes taken from the state, and the sleep set those asleep on
+  // every visit so far, all of them until the state is first reached.
+  process_set m_backtrack_set;
+  process_set m_done_set;
+  process_set m_sleep_set;
+  // processes whose next transition is enabled, set once the slots are
+  // and kept with the state
+  process_set m_enabled;
+
+  bool is_enabled(int proc) const;
+  void update_enabled(int proc);
+  void set_slot(int slot, int value)
+  {
+    m_hash ^= zobrist_key(slot, m_slots[slot]) ^ zobrist_key(slot, value);
+    m_slots[slot] = value;
+  }
 public:
-  state()
+  state(symbol_table const* symbols, int* slots)
+    : m_label(0), m_symbols(symbols), m_slots(slots), m_hash(0)
   { }
 
-  state(label label) : m_label(label)
-  { }
+  state(state const& other) = delete;
+  state& operator=(state const& other) = delete;
 
-  state(state const& other)
-    : m_shared_state(other.m_shared_state),
-      m_mutex_state(other.m_mutex_state),
-      m_loc_state(other.m_loc_state)
-  { }
+  int width() const { return m_symbols->width(); }
   
-  label get_label() { return m_label; }
-  void set_label(string label) { m_label = label; }
-  unordered_set<process*> get_backtrack_set() { return m_backtrack_set; }
-  void set_backtrack_set(unordered_set<process*> bs) { m_backtrack_set = bs; }
-  void add_to_backtrack_set(process* proc) { m_backtrack_set.insert(proc); }
-
-  unordered_set<process*> get_done_set() { return m_done_set; }
-  void set_done_set(unordered_set<process*> bs) { m_done_set = bs; }
-  void add_to_done_set(process* proc) { m_done_set.insert(proc); }
+  int get_label() { return m_label; }
+  void set_label(int label) { m_label = label; }
+  process_set const& get_backtrack_set() const { return m_backtrack_set; }
+  void set_backtrack_set(process_set const& bs) { m_backtrack_set = bs; }
+  void add_to_backtrack_set(int proc) { m_backtrack_set.insert(proc); }
+  void add_to_backtrack_set(process_set const& procs) { m_backtrack_set.set_union(procs); }
+
+  process_set const& get_done_set() const { return m_done_set; }
+  void set_done_set(process_set const& ds) { m_done_set = ds; }
+  void add_to_done_set(int proc) { m_done_set.insert(proc); }
+  void add_to_done_set(process_set const& procs) { m_done_set.set_union(procs); }
+
+  process_set const& get_sleep_set() const { return m_sleep_set; }
+  void set_sleep_set(process_set const& ss) { m_sleep_set = ss; }
+  void restrict_sleep_set(process_set const& ss) { m_sleep_set.set_intersection(ss); }
+
+  void clear_sets()
+  {
+    m_backtrack_set.clear();
+    m_done_set.clear();
+    m_sleep_set.clear();
+  }
 
-  unordered_set<process*> get_sleep_set() { return m_sleep_set; }
-  void add_to_sleep_set(process* proc) { m_sleep_set.insert(proc); }
+  int get_shared_value(int var) const { return m_slots[m_symbols->shared_slot(var)]; }
+  // id of the process owning the mutex, -1 if it is unlocked
+  int get_mutex_owner(int mutex_id) const { return m_slots[m_symbols->mutex_slot(mutex_id)]; }
+  int get_pc(int proc) const { return m_slots[m_symbols->pc_slot(proc)]; }
+  int const* get_slots() const { return m_slots; }
 
   // Returns the start state with all shared variables
   // initialized to zero, all mutex variables unlocked,
   // and pc's for all processes to zero
-  static state* get_start_state(
-    unordered_set<variable> const& shared_vars,
-    unordered_set<variable> const& mutex_vars,
-    unordered_map<label, process*> const& processes
-  )
+  static state* get_start_state(symbol_table const& symbols, state_arena& arena)
   {
-    auto ret = new state("0");
-    for (auto const& var : shared_vars) {
-      ret->m_shared_state.insert(make_pair(var, 0));
-    }
-    for (auto const& mutex : mutex_vars) {
-      ret->m_mutex_state.insert(make_pair(mutex, make_pair(unlocked, "")));
-    }
-    for (auto const& proc : processes) {
-      ret->m_loc_state.insert(make_pair(proc.first, 0));
+    auto ret = arena.allocate();
+    ret->m_label = 0;
+    memset(ret->m_slots, 0, symbols.width() * sizeof(int));
+    for (int i = 0; i < symbols.num_mutex_vars(); ++i) {
+      ret->m_slots[symbols.mutex_slot(i)] = -1;
     }
+    ret->m_hash = compute_hash(ret->m_slots, symbols.width());
+    ret->compute_enabled_set();
 
     return ret;
   }
 
+  // Returns a state holding a copy of slots, as restored from a checkpoint
+  static state* from_slots(symbol_table const& symbols, state_arena& arena, int const* slots)
+  {
+    auto ret = arena.allocate();
+    ret->m_label = 0;
+    memcpy(ret->m_slots, slots, symbols.width() * sizeof(int));
+    ret->m_hash = compute_hash(ret->m_slots, symbols.width());
+    ret->compute_enabled_set();
+    return ret;
+  }
+
   bool operator==(state const& other)
   {
-    return m_shared_state == other.m_shared_state
-      && m_mutex_state == other.m_mutex_state
-      && m_loc_state == other.m_loc_state;
+    return m_symbols == other.m_symbols
+      && memcmp(m_slots, other.m_slots, width() * sizeof(int)) == 0;
+  }
+
+  // Structural hash consistent with operator==, maintained incrementally
+  size_t hash() const { return m_hash; }
+
+  // Zobrist hash of a slot array, from scratch
+  static size_t compute_hash(int const* slots, int width)
+  {
+    size_t ret = 0;
+    for (int i = 0; i < width; ++i) {
+      ret ^= zobrist_key(i, slots[i]);
+    }
+    return ret;
   }
 
   string dump_string()
@@ -89,140 +152,494 @@ public:
     stringstream ss;
     ss << "State " << m_label << ":\n";
     ss << "\tSHARED_STATE:\n";
-    for (auto const& p : m_shared_state) {
-      ss << "\t\t" << p.first << " --> " << p.second << "\n";
+    for (int i = 0; i < m_symbols->num_shared_vars(); ++i) {
+      ss << "\t\t" << m_symbols->shared_var_name(i) << " --> " << get_shared_value(i) << "\n";
     }
 
     ss << "\tMUTEX_STATE:\n";
-    for (auto const& p : m_mutex_state) {
-      ss << "\t\t" << p.first << " --> " << enum_mutex_to_string(p.second.first) << ", " << p.second.second << "\n";
+    for (int i = 0; i < m_symbols->num_mutex_vars(); ++i) {
+      int owner = get_mutex_owner(i);
+      ss << "\t\t" << m_symbols->mutex_var_name(i) << " --> "
+        << enum_mutex_to_string(owner < 0 ? unlocked : locked) << ", "
+        << (owner < 0 ? "" : m_symbols->get_process(owner)->get_process_label()) << "\n";
     }
 
     ss << "\tLOC_STATE:\n";
-    for (auto const& p : m_loc_state) {
-      ss << "\t\t" << p.first << " --> " << p.second << "\n";
+    for (int i = 0; i < m_symbols->num_processes(); ++i) {
+      ss << "\t\t" << m_symbols->get_process(i)->get_process_label() << " --> " << get_pc(i) << "\n";
     }
 
     return ss.str();
   }
 
   // returns the next unique transaction to be executed by proc (may be enabled or disabled)
-  instruction* get_process_next_transition(process* const& proc);
-  unordered_set<process*> get_enabled_set(unordered_map<label, process*> const& all_procs);
-  state* get_next_state(instruction* const& ins);
+  // id of the next instruction of proc (enabled or not), -1 if proc has
+  // terminated
+  int get_next_instruction(int proc) const;
+  process_set const& get_enabled_set() const { return m_enabled; }
+  // Recomputes the enabled set from the slots
+  void compute_enabled_set();
+  state* get_next_state(int ins, state_arena& arena);
 };
 
 class transition
 {
 private:
   state* m_from_state;
-  instruction* m_action;
+  // instruction id and the process executing it
+  int m_action;
+  int m_proc;
   state* m_to_state;
 public:
   transition() {}
 
-  transition(state* const& from, instruction* const& action, state* const& to)
-    : m_from_state(from), m_to_state(to)
-  {
-    m_action = action;
-  }
+  transition(state* const& from, int action, int proc, state* const& to)
+    : m_from_state(from), m_action(action), m_proc(proc), m_to_state(to)
+  { }
 
   state* get_from_state() const { return m_from_state; }
   state* get_to_state() const { return m_to_state; }
-  instruction* get_action() const { return m_action; }
+  int get_action() const { return m_action; }
+  int get_process() const { return m_proc; }
 };
 
-// pid --> N mapping
-using clock_vector = unordered_map<label, int>;
-
+// Vector clocks are dense int arrays indexed by process id
 class clock_vectors
 {
 private:
-  unordered_map<label, clock_vector> m_process_map;
-  unordered_map<int, clock_vector> m_transition_map;
-  vector<label> m_ids;
+  int m_num_procs;
+  // row p is the clock of process p
+  vector<int> m_process_clocks;
+  // row n is the clock of the n-th transition of the current stack
+  vector<int> m_transition_clocks;
+  // undo log of process clock updates, as (process id, previous row) pairs
+  vector<int> m_saved_ids;
+  vector<int> m_saved_rows;
 
 public:
-  clock_vectors() {}
-  clock_vectors(vector<label> ids) : m_ids(ids)
+  clock_vectors() : m_num_procs(0) {}
+  clock_vectors(int num_procs)
+    : m_num_procs(num_procs),
+      m_process_clocks(num_procs * num_procs, 0),
+      m_transition_clocks(num_procs, 0)
   { }
 
-  clock_vector empty_clock_vector()
+  int size() const { return m_num_procs; }
+
+  int const* get_clock_vector(int proc) const { return &m_process_clocks[proc * m_num_procs]; }
+
+  // Clock of the n-th transition. The table grows as the stack gets deeper,
+  // so pointers into it are invalidated by a call with a larger n.
+  int* transition_clock_vector(int n)
   {
-    clock_vector ret;
-    for (auto const& p : m_ids) {
-      ret[p] = 0;
+    size_t end = (size_t) (n + 1) * m_num_procs;
+    if (m_transition_clocks.size() < end) {
+      m_transition_clocks.resize(max(end, 2 * m_transition_clocks.size()), 0);
     }
-    return ret;
+    return &m_transition_clocks[n * m_num_procs];
   }
-  
-  clock_vector get_clock_vector(label l)
+
+  // Overwrites the clock of process proc with cv. The previous value is
+  // logged so that rollback() can restore it.
+  void set_clock_vector(int proc, int const* cv)
   {
-    if (m_process_map.count(l)) {
-      return m_process_map[l];
-    }
-    clock_vector e = empty_clock_vector();
-    m_process_map[l] = e;
-    return e;
+    int* row = &m_process_clocks[proc * m_num_procs];
+    m_saved_ids.push_back(proc);
+    m_saved_rows.insert(m_saved_rows.end(), row, row + m_num_procs);
+    copy(cv, cv + m_num_procs, row);
   }
 
-  clock_vector get_clock_vector(int n)
+  int mark() const { return m_saved_ids.size(); }
+
+  // Undoes every set_clock_vector() made since mark was taken
+  void rollback(int mark)
   {
-    if (m_transition_map.count(n)) {
-      return m_transition_map[n];
+    while ((int) m_saved_ids.size() > mark) {
+      int proc = m_saved_ids.back();
+      auto saved = m_saved_rows.end() - m_num_procs;
+      copy(saved, m_saved_rows.end(), &m_process_clocks[proc * m_num_procs]);
+      m_saved_ids.pop_back();
+      m_saved_rows.resize(m_saved_rows.size() - m_num_procs);
     }
-    clock_vector e = empty_clock_vector();
-    m_transition_map[n] = e;
-    return e;
   }
 
-  void set_clock_vector(label l, clock_vector cv) { m_process_map[l] = cv; }
-  void set_clock_vector(int n, clock_vector cv) { m_transition_map[n] = cv; }
+  // Writes the process clocks, the clocks of the first depth transitions
+  // and the undo log to out
+  void save(checkpoint_buffer& out, int depth) const
+  {
+    out.put_array(m_process_clocks.data(), m_process_clocks.size());
+    out.put_array(m_transition_clocks.data(), (size_t) (depth + 1) * m_num_procs);
+    out.put<int32_t>(m_saved_ids.size());
+    out.put_array(m_saved_ids.data(), m_saved_ids.size());
+    out.put_array(m_saved_rows.data(), m_saved_rows.size());
+  }
 
-  clock_vector clock_vector_max(clock_vector cv1, clock_vector cv2)
+  // Reads back what save() wrote
+  void load(checkpoint_buffer& in, int depth)
   {
-    clock_vector ret = empty_clock_vector();
-    for (auto const& p : cv1) {
-      ret[p.first] = max(p.second, cv2[p.first]);
-    }
+    in.get_array(m_process_clocks.data(), m_process_clocks.size());
+    transition_clock_vector(depth);
+    in.get_array(m_transition_clocks.data(), (size_t) (depth + 1) * m_num_procs);
+    int saved = in.get<int32_t>();
+    m_saved_ids.resize(saved);
+    m_saved_rows.resize((size_t) saved * m_num_procs);
+    in.get_array(m_saved_ids.data(), m_saved_ids.size());
+    in.get_array(m_saved_rows.data(), m_saved_rows.size());
+  }
 
-    return ret;
+  // Elementwise max, dst = max(dst, src)
+  void clock_vector_max(int* dst, int const* src) const
+  {
+    for (int i = 0; i < m_num_procs; ++i) {
+      dst[i] = max(dst[i], src[i]);
+    }
   }
 
 };
 
+// DFS frame of the iterative explorer for the state reached after the
+// first d transitions of the stack, where d is the index of the frame
+class explore_frame
+{
+public:
+  state* m_state;
+  // C.mark() when the frame was entered, process clocks set while the
+  // frame is on top are rolled back to it before each transition taken
+  // from the frame and when the frame is left
+  int m_clock_mark;
+
+  explore_frame(state* s, int clock_mark) : m_state(s), m_clock_mark(clock_mark)
+  { }
+};
+
+// Exploration data owned by one thread. The sequential engine runs on a
+// single context, the parallel engine has one per worker.
+class explore_context
+{
+public:
+  int m_id;
+  vector<transition> m_stack;
+  clock_vectors m_clocks;
+  // one frame per state of m_stack, m_frames[d] is for the state reached
+  // after d transitions
+  vector<explore_frame> m_frames;
+  // stack entries below m_base were inherited from the task being run,
+  // their frames live on another worker (or have already returned)
+  int m_base;
+  // last accesses of the transitions of m_stack
+  access_index m_accesses;
+  state_arena m_arena;
+  // scratch of detect_races and reverse_race, indexed by process id
+  vector<int> m_races;
+  vector<int> m_reversal_first;
+  long m_transitions;
+  long m_executions;
+#ifdef DPOR_PROFILE
+  profile_counters m_profile;
+#endif
+
+  explore_context(int id, symbol_table const* symbols)
+    : m_id(id), m_clocks(symbols->num_processes()), m_base(0),
+      m_accesses(symbols->num_shared_vars(), symbols->num_mutex_vars(),
+        symbols->num_instructions(), symbols->num_processes()),
+      m_arena(symbols), m_races(symbols->num_processes()),
+      m_reversal_first(symbols->num_processes()), m_transitions(0), m_executions(0)
+  { }
+};
+
+// State of the optimal engine at one level of the current execution
+class optimal_frame
+{
+public:
+  state* m_state;
+  process_set m_sleep;
+  wakeup_tree m_wut;
+  // process explored from this state, -1 before the first one is chosen
+  int m_proc;
+};
+
+// Event of the current execution of the optimal engine. Its clock vector
+// is row (position + 1) of the transition clocks of the context.
+class optimal_event
+{
+public:
+  int m_proc;
+  int m_ins;
+  // 1-based position among the events of m_proc
+  int m_seq;
+  // position of the previous event of m_proc, -1 if none
+  int m_prev;
+  // size of optimal_context::m_races before the races of this event
+  int m_race_mark;
+};
+
+// Exploration data of the optimal engine, see optimal_dpor.cpp
+class optimal_context
+{
+public:
+  // events on different processes that are ordered in every execution:
+  // dependant instructions and all operations on the same lock
+  bit_matrix m_hb_dependancy;
+  // instruction ids of every process in program order
+  vector<vector<int>> m_proc_instructions;
+  // lock acquired or released by every instruction, -1 for other ones
+  vector<int> m_acquired_lock;
+  vector<int> m_released_lock;
+  // m_frames[d] is the state after d events, frames beyond m_depth are
+  // kept for reuse
+  vector<optimal_frame> m_frames;
+  int m_depth;
+  vector<optimal_event> m_events;
+  vector<int> m_last_event;
+  // (position of e, position of e') for every race e < e' of the execution
+  vector<pair<int, int>> m_races;
+  // scratch space of the wakeup tree insertion
+  vector<pair<int, int>> m_sequence;
+  vector<int> m_pcs;
+  vector<int> m_lock_clock;
+
+  long m_insertions;
+  long m_sleep_blocked;
+
+  optimal_context() : m_depth(0), m_insertions(0), m_sleep_blocked(0)
+  { }
+};
+
+// A subtree handed between workers: run process m_proc at the last state
+// of m_prefix, or explore that state itself if m_proc < 0
+class explore_task
+{
+public:
+  vector<transition> m_prefix;
+  clock_vectors m_clocks;
+  vector<explore_frame> m_frames;
+  int m_proc;
+  process_set m_sleep;
+};
+
+// Settings of a run, filled in from the command line
+class dpor_options
+{
+public:
+  int m_num_threads;
+  // stream the explored graph to the output file
+  bool m_write_graph;
+  // write the graph in the binary format of graph_format.hpp instead of DOT
+  bool m_binary_graph;
+  // no visited-state table, only the states on the stack are kept
+  bool m_stateless;
+  // optimal DPOR with wakeup trees, implies m_stateless
+  bool m_optimal;
+  // look up visited states modulo permutations of symmetric processes,
+  // single-threaded stateful search only
+  bool m_symmetry;
+  // write a checkpoint to this file every m_checkpoint_interval seconds,
+  // single-threaded classic engine only
+  string m_checkpoint_file;
+  double m_checkpoint_interval;
+  // continue the exploration saved in this checkpoint
+  string m_resume_file;
+  // bytes of visited states and their index kept in memory before
+  // spilling states to disk, 0 for no limit; single-threaded stateful
+  // search only
+  long m_mem_limit;
+  // bytes of the bit array of bitstate hashing, 0 to store visited states
+  // in full; the classic engine on a single thread only
+  long m_bitstate_bytes;
+  int m_bitstate_hashes;
+
+  dpor_options()
+    : m_num_threads(1), m_write_graph(true), m_binary_graph(false),
+      m_stateless(false), m_optimal(false), m_symmetry(false),
+      m_checkpoint_interval(60), m_mem_limit(0), m_bitstate_bytes(0),
+      m_bitstate_hashes(3)
+  { }
+};
+
 class dpor
 {
 private:
   string m_input_file;
   string m_dot_file;
   concurrent_procs* m_data;
-  vector<state*> m_states;
-  vector<transition> m_transitions;
+  int m_num_threads;
+  // NULL when the graph is not written
+  unique_ptr<graph_writer> m_graph;
+  // one context per thread, each owns the storage of the states it created;
+  // all states are released with the dpor object
+  vector<unique_ptr<explore_context>> m_contexts;
+  state_store m_states;
+  // used instead of m_states when m_num_threads > 1
+  concurrent_state_store m_shared_states;
+  // In stateless mode neither store is used: every state reached is new,
+  // and its storage is recycled when the DFS leaves it. m_num_states
+  // counts the states created.
+  bool m_stateless;
+  long m_num_states;
   state* m_start_state;
-  int m_executions;
+  // NULL unless looking up states modulo symmetry. A state reached that
+  // is a permutation of a visited one gets the label of that one and is
+  // not explored further; m_symmetric_hits counts them.
+  unique_ptr<symmetry> m_symmetry;
+  long m_symmetric_hits;
+  // NULL unless visited states are only remembered by bits in m_bitstate.
+  // States are then kept like in stateless mode, and the done sets the
+  // state store would keep are approximated by the table: a transition
+  // is only taken from a state if its bits are not all set yet.
+  unique_ptr<bitstate_table> m_bitstate;
+
+  // checkpointing, NULL if disabled. The sets of a stored state only
+  // change while it is on the stack, so they are recorded in m_delta when
+  // the state is left, while it is still in cache. m_delta_index[label] is
+  // the position of the record of a state in m_delta, if there is one.
+  unique_ptr<checkpoint_writer> m_checkpoint;
+  string m_resume_file;
+  unique_ptr<checkpoint_delta> m_delta;
+  vector<int> m_delta_index;
+
+  // With m_mem_limit > 0 the visited states and their index are limited
+  // to m_mem_limit bytes of memory, and m_spill_index and m_spill_states
+  // are used instead of m_states. Stored states that are not on the stack
+  // are then spilled to m_spill in the order they became resident, kept in
+  // m_spill_queue, leaving NULL in m_spill_states. The index stays in
+  // memory, so only a lookup whose fingerprint matches a spilled state
+  // reads the disk, and a spilled state found again is read back in.
+  unique_ptr<spill_table> m_spill;
+  long m_mem_limit;
+  long m_resident;
+  fingerprint_index m_spill_index;
+  vector<state*> m_spill_states;
+  deque<int> m_spill_queue;
+  long m_spill_lookups;
+  long m_spill_faults;
+  vector<char> m_spill_buffer;
+
+  size_t spill_record_size() const;
+  int const* spilled_slots(int label);
+  size_t stored_hash(int label);
+  // Stored state of label, NULL if spilled
+  state* stored_state(int label) const
+  {
+    return m_mem_limit > 0 ? m_spill_states[label] : m_states.at(label);
+  }
+  size_t spill_index_bytes() const;
+  void spill_states(explore_context& ctx);
+  state* unspill_state(explore_context& ctx, int label);
+  state* find_or_unspill(explore_context& ctx, state* s);
+
+  uint32_t checkpoint_flags() const
+  {
+    return (m_stateless ? checkpoint_stateless : 0) | (m_symmetry ? checkpoint_symmetry : 0);
+  }
+  int num_set_words() const { return (m_data->get_symbols().num_processes() + 63) / 64; }
+  void record_sets(state* s);
+  void take_checkpoint(explore_context& ctx);
+  void restore_checkpoint(explore_context& ctx);
+
+  // parallel engine
+  vector<unique_ptr<work_deque<explore_task>>> m_deques;
+  vector<std::mutex> m_state_locks;
+  atomic<long> m_pending_tasks;
+  atomic<int> m_idle_workers;
+  atomic<long> m_spawned_tasks;
+  atomic<long> m_stolen_tasks;
+
+  // Guards the backtrack, done and sleep sets of s against other workers,
+  // does not lock anything when exploring on a single thread
+  unique_lock<std::mutex> lock_state(state* const& s)
+  {
+    if (m_num_threads == 1) {
+      return unique_lock<std::mutex>();
+    }
+    return unique_lock<std::mutex>(m_state_locks[s->get_label() % m_state_locks.size()]);
+  }
+
+  void push_access(explore_context& ctx, int pos);
+  void detect_races(explore_context& ctx, int p, int b, bool taken);
+  void reverse_race(explore_context& ctx, int index, int p, int b, bool taken);
+  void detect_cached_races(explore_context& ctx, state* s);
+  bool enter_state(explore_context& ctx);
+  void leave_state(explore_context& ctx, int entry_depth);
+  void push_transition(explore_context& ctx, state* last_state, int proc, process_set const& sleep);
+  void explore_frames(explore_context& ctx, int entry_depth);
+  bool should_spawn(explore_context& ctx);
+  void spawn_task(explore_context& ctx, int depth, int proc, process_set const& sleep);
+  void run_task(explore_context& ctx, explore_task* task);
+  explore_task* steal_task(int thief);
+  void run_worker(int id);
+  void parallel_por();
+
+  // optimal engine
+  bool m_optimal;
+  unique_ptr<optimal_context> m_optimal_ctx;
+
+  void optimal_init();
+  void optimal_push_frame(state* s, process_set const& sleep);
+  void optimal_pop_frame();
+  void optimal_push_event(int proc, int ins);
+  void optimal_race_reversals();
+  bool optimal_weak_initial(int proc);
+  void optimal_insert(int depth);
+  void optimal_por();
 
 public:
   dpor() {}
 
-  dpor(concurrent_procs* all_procs, string input, string dot_file)
-    : m_input_file(input), m_dot_file(dot_file)
+  dpor(concurrent_procs* all_procs, string input, string dot_file, dpor_options const& options)
+    : m_input_file(input), m_dot_file(dot_file),
+      m_num_threads(max(options.m_num_threads, 1)),
+      m_stateless(options.m_stateless || options.m_optimal || options.m_bitstate_bytes > 0),
+      m_num_states(0),
+      m_symmetric_hits(0), m_resume_file(options.m_resume_file),
+      m_mem_limit(m_stateless || m_num_threads > 1 ? 0 : options.m_mem_limit),
+      m_resident(0),
+      m_spill_lookups(0), m_spill_faults(0),
+      m_state_locks(m_num_threads > 1 ? 1024 : 0),
+      m_pending_tasks(0), m_idle_workers(0),
+      m_spawned_tasks(0), m_stolen_tasks(0),
+      m_optimal(options.m_optimal)
   {
     m_data = all_procs;
-    m_executions = 0;
+    if (options.m_symmetry && !m_stateless && m_num_threads == 1) {
+      m_symmetry.reset(new symmetry(*all_procs));
+    }
+    if (options.m_bitstate_bytes > 0 && !m_optimal && m_num_threads == 1) {
+      m_bitstate.reset(new bitstate_table(options.m_bitstate_bytes, options.m_bitstate_hashes));
+    }
+    for (int i = 0; i < m_num_threads; ++i) {
+      m_contexts.emplace_back(new explore_context(i, &all_procs->get_symbols()));
+    }
+    if (!options.m_checkpoint_file.empty() && !m_optimal && m_num_threads == 1) {
+      m_checkpoint.reset(new checkpoint_writer(options.m_checkpoint_file,
+        options.m_checkpoint_interval, checkpoint_flags(), checkpoint_fingerprint(*all_procs),
+        all_procs->get_symbols().width(), num_set_words()));
+      m_delta.reset(new checkpoint_delta());
+    }
+    if (options.m_write_graph && options.m_binary_graph) {
+      m_graph.reset(new binary_graph_writer(dot_file, all_procs->get_symbols(), m_num_threads > 1));
+    } else if (options.m_write_graph) {
+      m_graph.reset(new dot_graph_writer(dot_file, all_procs->get_symbols(), m_num_threads > 1));
+    }
   }
 
   void initialize_with_start_state()
   {
-    unordered_set<variable> shared_vars, mutex_vars;
-    auto processes = m_data->get_processes();
-    for (auto const& m : processes) {
-      unordered_set_union(shared_vars, m.second->get_shared_vars());
-      unordered_set_union(mutex_vars, m.second->get_mutex_vars());
-    }
-    state* start = state::get_start_state(shared_vars, mutex_vars, m_data->get_processes());
+    state* start = state::get_start_state(m_data->get_symbols(), m_contexts[0]->m_arena);
     // cout << start->dump_string() << endl;
-    m_states.push_back(start);
+    if (m_stateless) {
+      start->set_label(m_num_states++);
+    } else if (m_mem_limit > 0) {
+      find_or_unspill(*m_contexts[0], start);
+      m_resident++;
+    } else if (m_num_threads == 1) {
+      m_states.find_or_insert(start, m_symmetry ? m_symmetry->hash(start->get_slots()) : start->hash());
+      m_resident++;
+    } else {
+      m_shared_states.find_or_insert(start);
+    }
+    if (m_graph) {
+      m_graph->add_state(start->get_label());
+    }
     m_start_state = start;
   }
 
@@ -234,21 +651,135 @@ public:
     return S[S.size()-1].get_to_state();
   }
 
-  state* find_state(state* const& s);
+  state* find_state(explore_context& ctx, state* const& s);
   void dynamic_por();
-  void explore(vector<transition> &stack, clock_vectors C);
+  // Finishes the graph output, dynamic_por only streams it
+  void close_graph();
+  void explore(explore_context& ctx);
+
+#ifdef DPOR_PROFILE
+  // Profiling counters of all contexts as one JSON object
+  // explore_allocations is the number of heap allocations made by
+  // dynamic_por()
+  string get_profile(long explore_allocations)
+  {
+    profile_counters total;
+    for (auto const& ctx : m_contexts) {
+      total.add(ctx->m_profile);
+    }
+    long probes = m_stateless ? 0 : m_mem_limit > 0 ? m_spill_index.probes()
+      : m_num_threads == 1 ? m_states.probes() : m_shared_states.probes();
+    return total.to_json("\"find_state_probes\": " + to_string(probes) + ", "
+      + "\"explore_heap_allocations\": " + to_string(explore_allocations) + ", ");
+  }
+#endif
+
+  long num_executions() const
+  {
+    long executions = 0;
+    for (auto const& ctx : m_contexts) {
+      executions += ctx->m_executions;
+    }
+    return executions;
+  }
+
+  long num_transitions() const
+  {
+    long transitions = 0;
+    for (auto const& ctx : m_contexts) {
+      transitions += ctx->m_transitions;
+    }
+    return transitions;
+  }
+
+  long num_states() const
+  {
+    if (m_stateless) {
+      return m_num_states;
+    }
+    if (m_mem_limit > 0) {
+      return m_spill_states.size();
+    }
+    return m_num_threads == 1 ? m_states.size() : m_shared_states.size();
+  }
+
+  // Exploration throughput given the time spent in dynamic_por
+  string get_rates(long explore_us)
+  {
+    long transitions = num_transitions();
+    long states = num_states();
+    double seconds = max(explore_us, 1L) / 1e6;
+
+    stringstream ss;
+    ss << fixed << setprecision(0);
+    ss << "STATES_PER_SEC = " << states / seconds << "\n";
+    ss << "TRANSITIONS_PER_SEC = " << transitions / seconds << "\n";
+    return ss.str();
+  }
 
   string get_stats()
   {
+    long transitions = 0, executions = 0, allocations = 0, recycled = 0;
+    size_t arena_bytes = 0;
+    for (auto const& ctx : m_contexts) {
+      transitions += ctx->m_transitions;
+      executions += ctx->m_executions;
+      allocations += ctx->m_arena.allocations();
+      recycled += ctx->m_arena.recycled();
+      arena_bytes += ctx->m_arena.reserved_bytes();
+    }
+
     stringstream ss;
-    ss << "NUM_STATES = " << m_states.size() << "\n";
-    ss << "NUM_TRANSITIONS = " << m_transitions.size() << "\n";
-    ss << "NUM_EXECUTIONS = " << m_executions << "\n";
+    ss << "NUM_STATES = " << num_states() << "\n";
+    ss << "NUM_TRANSITIONS = " << transitions << "\n";
+    ss << "NUM_EXECUTIONS = " << executions << "\n";
+    if (m_optimal) {
+      ss << "OPTIMAL = 1\n";
+      ss << "WAKEUP_INSERTIONS = " << m_optimal_ctx->m_insertions << "\n";
+      ss << "SLEEP_BLOCKED = " << m_optimal_ctx->m_sleep_blocked << "\n";
+    } else if (m_bitstate) {
+      ss << m_bitstate->dump_stats();
+    } else if (m_stateless) {
+      ss << "STATELESS = 1\n";
+    } else if (m_num_threads == 1) {
+      if (!m_spill) {
+        ss << m_states.dump_stats();
+      } else {
+        ss << m_spill_index.dump_stats();
+        ss << "SPILL_MEM_LIMIT = " << m_mem_limit << "\n";
+        ss << "SPILL_RESIDENT_STATES = " << m_resident << "\n";
+        ss << "SPILL_RESIDENT_BYTES = " << m_resident * m_contexts[0]->m_arena.record_size() << "\n";
+        ss << "SPILL_INDEX_BYTES = " << spill_index_bytes() << "\n";
+        ss << "SPILLED_STATES = " << num_states() - m_resident << "\n";
+        ss << "SPILLED_BYTES = " << (num_states() - m_resident) * m_spill->record_size() << "\n";
+        ss << "SPILL_LOOKUPS = " << m_spill_lookups << "\n";
+        ss << "SPILL_FAULTS = " << m_spill_faults << "\n";
+      }
+      if (m_symmetry) {
+        ss << m_symmetry->dump_string();
+        ss << "SYMMETRIC_HITS = " << m_symmetric_hits << "\n";
+      }
+    } else {
+      ss << m_shared_states.dump_stats();
+    }
+    if (m_checkpoint) {
+      ss << m_checkpoint->dump_stats();
+    }
+    ss << "ARENA_RESERVED_BYTES = " << arena_bytes << "\n";
+    ss << "ARENA_ALLOCATIONS = " << allocations << "\n";
+    ss << "ARENA_RECYCLED = " << recycled << "\n";
+    if (m_num_threads > 1) {
+      ss << "NUM_THREADS = " << m_num_threads << "\n";
+      ss << "TASKS_SPAWNED = " << m_spawned_tasks << "\n";
+      ss << "TASKS_STOLEN = " << m_stolen_tasks << "\n";
+      for (auto const& ctx : m_contexts) {
+        ss << "THREAD_" << ctx->m_id << " = " << ctx->m_transitions << " transitions, "
+          << ctx->m_executions << " executions\n";
+      }
+    }
 
     return ss.str();
   }
-
-  void print_to_dot_format();
 };
 
 #endif
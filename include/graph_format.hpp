@@ -0,0 +1,40 @@
+#ifndef GRAPH_FORMAT_HPP
+#define GRAPH_FORMAT_HPP
+
+#include <stdint.h>
+
+// Layout of the binary graph file written with --binary. All integers are
+// in host byte order, and every section starts at a 4-byte aligned offset:
+//
+//   graph_file_header
+//   action table: per instruction id, a uint32 length and the DOT label
+//                 of the instruction, padded to a multiple of 4 bytes
+//   edge records: num_edges graph_edge records in exploration order
+//   state table:  num_states int32 state labels in discovery order
+//
+// The counts and the state table offset are filled in when the file is
+// closed, a file whose num_states is still 0 was not finished.
+
+static const char graph_file_magic[8] = { 'D', 'P', 'O', 'R', 'G', 'R', 'F', '\0' };
+static const uint32_t graph_file_version = 1;
+
+struct graph_file_header
+{
+  char m_magic[8];
+  uint32_t m_version;
+  uint32_t m_num_actions;
+  uint64_t m_num_states;
+  uint64_t m_num_edges;
+  uint64_t m_actions_offset;
+  uint64_t m_edges_offset;
+  uint64_t m_states_offset;
+};
+
+struct graph_edge
+{
+  int32_t m_from;
+  int32_t m_action;
+  int32_t m_to;
+};
+
+#endif
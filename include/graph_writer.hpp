@@ -0,0 +1,77 @@
+#ifndef GRAPH_WRITER_HPP
+#define GRAPH_WRITER_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <mutex>
+#include "graph_format.hpp"
+
+using namespace std;
+
+class symbol_table;
+
+// Receives the explored graph while the search runs, so that states and
+// transitions need not be kept around until the end. Labels are the state
+// labels, actions are dense instruction ids.
+class graph_writer
+{
+public:
+  virtual ~graph_writer() {}
+  virtual void add_state(int label) = 0;
+  virtual void add_transition(int from, int action, int to) = 0;
+  // Writes any buffered output and the trailer of the file
+  virtual void close() = 0;
+};
+
+// Streams the graph as DOT. Output is collected in a buffer that is
+// written out whenever it grows past a fixed size. With shared set, calls
+// from several threads are serialized by the writer.
+class dot_graph_writer : public graph_writer
+{
+private:
+  ofstream m_out;
+  string m_buffer;
+  // DOT label of every instruction, by instruction id
+  vector<string> m_action_labels;
+  bool m_shared;
+  std::mutex m_lock;
+  bool m_closed;
+
+  void flush_if_full();
+
+public:
+  dot_graph_writer(string const& file, symbol_table const& symbols, bool shared);
+  ~dot_graph_writer();
+
+  void add_state(int label);
+  void add_transition(int from, int action, int to);
+  void close();
+};
+
+// Streams the graph in the binary format of graph_format.hpp. Edge records
+// are buffered like the DOT output, state labels are kept in memory and
+// appended when the file is closed, after which the header is patched.
+class binary_graph_writer : public graph_writer
+{
+private:
+  ofstream m_out;
+  vector<graph_edge> m_buffer;
+  vector<int32_t> m_states;
+  graph_file_header m_header;
+  bool m_shared;
+  std::mutex m_lock;
+  bool m_closed;
+
+  void flush_edges();
+
+public:
+  binary_graph_writer(string const& file, symbol_table const& symbols, bool shared);
+  ~binary_graph_writer();
+
+  void add_state(int label);
+  void add_transition(int from, int action, int to);
+  void close();
+};
+
+#endif
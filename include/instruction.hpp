@@ -23,18 +23,26 @@ class instruction
 protected:
   label m_label;
   label m_process_id;
+  int m_process_index;
+  // dense id over all instructions of the program
+  int m_index;
   instruction_type m_type;
 public:
-  instruction()
+  instruction() : m_process_index(-1), m_index(-1)
   { }
-  instruction(label label) : m_label(label)
+  instruction(label label) : m_label(label), m_process_index(-1), m_index(-1)
   { }
+  virtual ~instruction() {}
 
   void set_label(label label) { m_label = label; }
-  label get_instruction_label() { return m_label; }
+  label const& get_instruction_label() const { return m_label; }
   void set_process_id(label proc) { m_process_id = proc; }
-  label get_process_id() { return m_process_id; }
-  instruction_type get_instruction_type() { return m_type; }
+  label const& get_process_id() const { return m_process_id; }
+  void set_process_index(int index) { m_process_index = index; }
+  int get_process_index() const { return m_process_index; }
+  void set_index(int index) { m_index = index; }
+  int get_index() const { return m_index; }
+  instruction_type get_instruction_type() const { return m_type; }
 
   virtual string dump_string() const { return ""; }
 };
@@ -47,42 +55,33 @@ private:
   variable m_right_var;
   int m_right_val;
   bool m_is_constant;
+  // interned ids of m_left and m_right_var
+  int m_left_id;
+  int m_right_var_id;
 
 public:
   assignment_instruction(variable left, variable right)
-    : m_left(left), m_right_var(right), m_is_constant(false)
+    : m_left(left), m_right_var(right), m_is_constant(false),
+      m_left_id(-1), m_right_var_id(-1)
   {
     m_type = assignment;
   }
 
   assignment_instruction(variable left, int right)
-    : m_left(left), m_right_val(right), m_is_constant(true)
+    : m_left(left), m_right_val(right), m_is_constant(true),
+      m_left_id(-1), m_right_var_id(-1)
   {
     m_type = assignment;
   }
 
-  variable get_lhs() { return m_left; }
-  bool is_constant_assignment() { return m_is_constant; }
-  int get_rhs_val() { return m_right_val; }
-  variable get_rhs_var() { return m_right_var; }
+  variable const& get_lhs() const { return m_left; }
+  bool is_constant_assignment() const { return m_is_constant; }
+  int get_rhs_val() const { return m_right_val; }
+  variable const& get_rhs_var() const { return m_right_var; }
 
-  bool are_dependant(assignment_instruction* const& other)
-  { 
-    // Data races between 2 assignment instructions
-    if (this->m_left == other->m_left) {
-      return true;
-    }
-    if (this->m_is_constant && other->m_is_constant) {
-      return false;
-    } else if (this->m_is_constant) {
-      return this->m_left == other->m_right_var;
-    } else if (other->m_is_constant) {
-      return other->m_left == this->m_right_var;
-    } else {
-      return this->m_left == other->m_right_var || other->m_left == this->m_right_var;
-    }
-    return false;
-  }
+  void set_variable_ids(int left, int right) { m_left_id = left; m_right_var_id = right; }
+  int get_lhs_id() const { return m_left_id; }
+  int get_rhs_var_id() const { return m_right_var_id; }
 
   string dump_string() const override
   {
@@ -104,23 +103,20 @@ class mutex_instruction : public instruction
 private:
   variable m_mutex_var;
   bool m_is_acquire;
+  // interned id of m_mutex_var
+  int m_mutex_id;
 
 public:
   mutex_instruction(variable var, bool mode)
-    : m_mutex_var(var), m_is_acquire(mode)
+    : m_mutex_var(var), m_is_acquire(mode), m_mutex_id(-1)
   {
-    m_type = mutex;
+    m_type = instruction_type::mutex;
   }
 
-  variable get_mutex_var() { return m_mutex_var; }
-  bool is_acquire() {return m_is_acquire; }
-
-  bool are_dependant(mutex_instruction* const& other)
-  {
-    // 2 acquires on the same shared variable are dependant
-    return this->m_mutex_var == other->m_mutex_var
-      && this->m_is_acquire && other->m_is_acquire;
-  }
+  variable const& get_mutex_var() const { return m_mutex_var; }
+  void set_mutex_id(int id) { m_mutex_id = id; }
+  int get_mutex_id() const { return m_mutex_id; }
+  bool is_acquire() const { return m_is_acquire; }
 
   string dump_string() const override
   {
@@ -153,10 +149,11 @@ public:
     : m_set(vec.begin(), vec.end())
   { }
 
-  void add_pair(label l1, label l2) { m_set.insert(make_pair(l1, l2)); }
+  void add_pair(label const& l1, label const& l2) { m_set.emplace(l1, l2); }
   bool exists(label l1, label l2) { return m_set.count(make_pair(l1, l2)) != 0; }
 
   int size() { return m_set.size(); }
+  unordered_set<pair<label, label>, hash<pair<label, label>>> const& get_pairs() const { return m_set; }
 
   void relation_union(binary_label_relation const& other)
   {
@@ -0,0 +1,116 @@
+#ifndef INSTRUCTION_TABLE_HPP
+#define INSTRUCTION_TABLE_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <cassert>
+#include "instruction.hpp"
+
+using namespace std;
+
+enum opcode : uint8_t {
+  // m_operand := m_source
+  op_assign_const,
+  // m_operand := shared variable m_source
+  op_assign_var,
+  // acquire / release mutex m_operand
+  op_acquire,
+  op_release
+};
+
+// The instructions of a program lowered to parallel arrays indexed by
+// instruction id, built once by symbol_table::lower_instructions() after
+// the symbols are interned. The exploration dispatches on the opcode with
+// a switch and never touches the instruction objects. The instructions of
+// a process have consecutive ids in program order.
+class instruction_table
+{
+private:
+  vector<uint8_t> m_opcode;
+  // assigned shared variable or mutex id
+  vector<int> m_operand;
+  // assigned constant or read shared variable, -1 for mutex operations
+  vector<int> m_source;
+  vector<int> m_proc;
+  // [proc] id of the first instruction and number of instructions
+  vector<int> m_proc_first;
+  vector<int> m_proc_size;
+
+public:
+  // Appends ins, whose id must be the size of the table
+  void add(instruction* ins)
+  {
+    assert(ins->get_index() == (int) m_opcode.size());
+    int proc = ins->get_process_index();
+    if (proc >= (int) m_proc_first.size()) {
+      m_proc_first.resize(proc + 1, ins->get_index());
+      m_proc_size.resize(proc + 1, 0);
+    }
+    assert(m_proc_first[proc] + m_proc_size[proc] == ins->get_index());
+    m_proc_size[proc]++;
+    m_proc.push_back(proc);
+    if (ins->get_instruction_type() == assignment) {
+      auto assign = static_cast<assignment_instruction*>(ins);
+      m_operand.push_back(assign->get_lhs_id());
+      if (assign->is_constant_assignment()) {
+        m_opcode.push_back(op_assign_const);
+        m_source.push_back(assign->get_rhs_val());
+      } else {
+        m_opcode.push_back(op_assign_var);
+        m_source.push_back(assign->get_rhs_var_id());
+      }
+    } else {
+      auto mut = static_cast<mutex_instruction*>(ins);
+      m_opcode.push_back(mut->is_acquire() ? op_acquire : op_release);
+      m_operand.push_back(mut->get_mutex_id());
+      m_source.push_back(-1);
+    }
+  }
+
+  int size() const { return m_opcode.size(); }
+  opcode get_opcode(int ins) const { return (opcode) m_opcode[ins]; }
+  int get_operand(int ins) const { return m_operand[ins]; }
+  int get_source(int ins) const { return m_source[ins]; }
+  int get_process(int ins) const { return m_proc[ins]; }
+  bool is_mutex(int ins) const { return m_opcode[ins] >= op_acquire; }
+
+  // id of the instruction of proc at pc, -1 if proc has terminated
+  int at(int proc, int pc) const
+  {
+    return pc < m_proc_size[proc] ? m_proc_first[proc] + pc : -1;
+  }
+
+  int written_var(int ins) const { return is_mutex(ins) ? -1 : m_operand[ins]; }
+  int read_var(int ins) const { return m_opcode[ins] == op_assign_var ? m_source[ins] : -1; }
+  int acquired_lock(int ins) const { return m_opcode[ins] == op_acquire ? m_operand[ins] : -1; }
+  int released_lock(int ins) const { return m_opcode[ins] == op_release ? m_operand[ins] : -1; }
+
+  // Data races between two assignments, and two acquires of the same mutex
+  bool are_dependant(int a, int b) const
+  {
+    if (is_mutex(a) != is_mutex(b)) {
+      return false;
+    }
+    if (is_mutex(a)) {
+      return m_operand[a] == m_operand[b]
+        && m_opcode[a] == op_acquire && m_opcode[b] == op_acquire;
+    }
+    return m_operand[a] == m_operand[b]
+      || m_operand[a] == read_var(b) || m_operand[b] == read_var(a);
+  }
+
+  // Instructions of different processes may be co-enabled, unless one
+  // acquires and the other releases the same mutex
+  bool may_be_coenabled(int a, int b) const
+  {
+    if (m_proc[a] == m_proc[b]) {
+      return false;
+    }
+    if (is_mutex(a) && is_mutex(b)) {
+      return !(m_operand[a] == m_operand[b] && m_opcode[a] != m_opcode[b]);
+    }
+    return true;
+  }
+};
+
+#endif
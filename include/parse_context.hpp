@@ -0,0 +1,39 @@
+#ifndef PARSE_CONTEXT_HPP
+#define PARSE_CONTEXT_HPP
+
+#include <string>
+#include <memory>
+#include <unordered_set>
+#include "program.hpp"
+
+using namespace std;
+
+// State of one parse, shared by the scanner (as its extra data) and the
+// parser. The scanner interns every identifier once, tokens carry a
+// pointer to the interned name, and the parser adds processes and
+// program order pairs straight into the program.
+class parse_context
+{
+private:
+  unordered_set<string> m_names;
+  unique_ptr<concurrent_procs> m_program;
+
+public:
+  parse_context() : m_program(new concurrent_procs())
+  { }
+
+  parse_context(parse_context const& other) = delete;
+  parse_context& operator=(parse_context const& other) = delete;
+
+  // The interned copy of text, valid as long as the context
+  string const* intern(char const* text, size_t length)
+  {
+    return &*m_names.emplace(text, length).first;
+  }
+
+  concurrent_procs* get_program() { return m_program.get(); }
+  // Hands the parsed program over to the caller
+  concurrent_procs* release_program() { return m_program.release(); }
+};
+
+#endif
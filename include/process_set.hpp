@@ -0,0 +1,159 @@
+#ifndef PROCESS_SET_HPP
+#define PROCESS_SET_HPP
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+// Set of dense process ids stored as a bitset. Ids below 64 live in an
+// inline word, so programs with at most 64 processes never allocate;
+// larger ids spill into m_overflow.
+class process_set
+{
+private:
+  uint64_t m_word;
+  vector<uint64_t> m_overflow;
+
+  uint64_t word(size_t i) const
+  {
+    if (i == 0) {
+      return m_word;
+    }
+    return i <= m_overflow.size() ? m_overflow[i - 1] : 0;
+  }
+
+  uint64_t& word_ref(size_t i)
+  {
+    if (i == 0) {
+      return m_word;
+    }
+    if (i > m_overflow.size()) {
+      m_overflow.resize(i, 0);
+    }
+    return m_overflow[i - 1];
+  }
+
+  size_t num_words() const { return m_overflow.size() + 1; }
+
+public:
+  process_set() : m_word(0)
+  { }
+
+  void insert(int id) { word_ref(id >> 6) |= (uint64_t) 1 << (id & 63); }
+
+  void erase(int id)
+  {
+    if ((size_t) (id >> 6) < num_words()) {
+      word_ref(id >> 6) &= ~((uint64_t) 1 << (id & 63));
+    }
+  }
+
+  bool contains(int id) const { return (word(id >> 6) >> (id & 63)) & 1; }
+
+  bool empty() const
+  {
+    for (size_t i = 0; i < num_words(); ++i) {
+      if (word(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  int size() const
+  {
+    int ret = 0;
+    for (size_t i = 0; i < num_words(); ++i) {
+      ret += __builtin_popcountll(word(i));
+    }
+    return ret;
+  }
+
+  void clear()
+  {
+    m_word = 0;
+    m_overflow.clear();
+  }
+
+  // Smallest element greater than id (or the smallest element if id < 0),
+  // -1 if there is none
+  int next(int id) const
+  {
+    size_t i = id < 0 ? 0 : (id + 1) >> 6;
+    uint64_t w = word(i);
+    if (id >= 0) {
+      int bit = (id + 1) & 63;
+      w = bit ? (w >> bit) << bit : w;
+    }
+    while (true) {
+      if (w) {
+        return (i << 6) + __builtin_ctzll(w);
+      }
+      if (++i >= num_words()) {
+        return -1;
+      }
+      w = word(i);
+    }
+  }
+
+  int first() const { return next(-1); }
+
+  // Word i of the bitset, holding ids 64 * i to 64 * i + 63
+  uint64_t get_word(size_t i) const { return word(i); }
+  void set_word(size_t i, uint64_t w)
+  {
+    if (w || i < num_words()) {
+      word_ref(i) = w;
+    }
+  }
+
+  // Smallest element of this \ other, -1 if there is none
+  int first_not_in(process_set const& other) const
+  {
+    for (size_t i = 0; i < num_words(); ++i) {
+      uint64_t w = word(i) & ~other.word(i);
+      if (w) {
+        return (i << 6) + __builtin_ctzll(w);
+      }
+    }
+    return -1;
+  }
+
+  void set_union(process_set const& other)
+  {
+    for (size_t i = other.num_words(); i-- > 0; ) {
+      if (other.word(i)) {
+        word_ref(i) |= other.word(i);
+      }
+    }
+  }
+
+  void set_difference(process_set const& other)
+  {
+    for (size_t i = 0; i < num_words(); ++i) {
+      word_ref(i) &= ~other.word(i);
+    }
+  }
+
+  void set_intersection(process_set const& other)
+  {
+    for (size_t i = 0; i < num_words(); ++i) {
+      word_ref(i) &= other.word(i);
+    }
+  }
+
+  bool operator==(process_set const& other) const
+  {
+    size_t n = max(num_words(), other.num_words());
+    for (size_t i = 0; i < n; ++i) {
+      if (word(i) != other.word(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+#endif
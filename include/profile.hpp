@@ -0,0 +1,125 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+
+using namespace std;
+
+// Opt-in counters and timers for the hot paths of the explorer. They are
+// only compiled in with -DDPOR_PROFILE (make profile); otherwise the
+// DPOR_COUNT and DPOR_TIME macros expand to nothing and their arguments
+// are never evaluated.
+
+enum profile_counter {
+  count_race_iterations,
+  count_find_state_lookups,
+  count_find_state_hits,
+  count_enabled_set_calls,
+  count_clock_joins,
+  count_sleep_prunes,
+  count_backtrack_insertions,
+  num_profile_counters
+};
+
+enum profile_timer {
+  time_race_detection,
+  time_find_state,
+  time_next_state,
+  num_profile_timers
+};
+
+// Counters of one exploration context, summed over contexts at the end
+class profile_counters
+{
+private:
+  long m_counts[num_profile_counters];
+  long m_nanos[num_profile_timers];
+
+public:
+  profile_counters()
+  {
+    fill(m_counts, m_counts + num_profile_counters, 0);
+    fill(m_nanos, m_nanos + num_profile_timers, 0);
+  }
+
+  void count(profile_counter c, long n) { m_counts[c] += n; }
+  void add_time(profile_timer t, long nanos) { m_nanos[t] += nanos; }
+  long get_count(profile_counter c) const { return m_counts[c]; }
+  long get_nanos(profile_timer t) const { return m_nanos[t]; }
+
+  void add(profile_counters const& other)
+  {
+    for (int i = 0; i < num_profile_counters; ++i) {
+      m_counts[i] += other.m_counts[i];
+    }
+    for (int i = 0; i < num_profile_timers; ++i) {
+      m_nanos[i] += other.m_nanos[i];
+    }
+  }
+
+  // One JSON object with every counter and the timers in microseconds.
+  // extra is inserted as further members, e.g. "\"a\": 1, "
+  string to_json(string const& extra) const
+  {
+    static char const* counter_names[] = {
+      "race_iterations", "find_state_lookups", "find_state_hits",
+      "enabled_set_calls", "clock_joins", "sleep_prunes", "backtrack_insertions"
+    };
+    static char const* timer_names[] = {
+      "race_detection_us", "find_state_us", "next_state_us"
+    };
+    stringstream ss;
+    ss << "{";
+    for (int i = 0; i < num_profile_counters; ++i) {
+      ss << "\"" << counter_names[i] << "\": " << m_counts[i] << ", ";
+    }
+    ss << extra;
+    ss << "\"timers\": {";
+    for (int i = 0; i < num_profile_timers; ++i) {
+      ss << (i ? ", " : "") << "\"" << timer_names[i] << "\": " << m_nanos[i] / 1000;
+    }
+    ss << "}}";
+    return ss.str();
+  }
+};
+
+// Adds the time until the end of the enclosing scope to a timer
+class profile_scope
+{
+private:
+  profile_counters& m_counters;
+  profile_timer m_timer;
+  chrono::steady_clock::time_point m_begin;
+
+public:
+  profile_scope(profile_counters& counters, profile_timer t)
+    : m_counters(counters), m_timer(t), m_begin(chrono::steady_clock::now())
+  { }
+
+  ~profile_scope()
+  {
+    auto nanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - m_begin);
+    m_counters.add_time(m_timer, nanos.count());
+  }
+};
+
+#define DPOR_PROFILE_CONCAT_(a, b) a##b
+#define DPOR_PROFILE_CONCAT(a, b) DPOR_PROFILE_CONCAT_(a, b)
+
+#ifdef DPOR_PROFILE
+// Number of calls to operator new so far, see bench/alloc_count.cpp
+long profile_heap_allocations();
+
+#define DPOR_COUNT(ctx, c) ((ctx).m_profile.count(c, 1))
+#define DPOR_COUNT_N(ctx, c, n) ((ctx).m_profile.count(c, n))
+#define DPOR_TIME(ctx, t) profile_scope DPOR_PROFILE_CONCAT(profile_scope_, __LINE__)((ctx).m_profile, t)
+#else
+#define DPOR_COUNT(ctx, c) ((void) 0)
+#define DPOR_COUNT_N(ctx, c, n) ((void) 0)
+#define DPOR_TIME(ctx, t) ((void) 0)
+#endif
+
+#endif
@@ -3,6 +3,9 @@
 
 #include <unordered_map>
 #include "instruction.hpp"
+#include "instruction_table.hpp"
+#include "bit_matrix.hpp"
+#include "process_set.hpp"
 
 using namespace std;
 
@@ -11,25 +14,41 @@ class process
 private:
   label m_process_label;
   vector<instruction*> m_list;
+  // dense id assigned by concurrent_procs::intern_symbols()
+  int m_index;
 public:
-  process(label label) : m_process_label(label)
+  process(label label) : m_process_label(label), m_index(-1)
   { }
 
   process(label label, vector<instruction*> const& ins_list)
-    : m_process_label(label), m_list(ins_list)
+    : m_process_label(label), m_list(ins_list), m_index(-1)
   { }
 
   process(vector<instruction*> const& ins_list)
-    : m_list(ins_list)
+    : m_list(ins_list), m_index(-1)
   { }
 
+  // a process owns its instructions
+  process(process const& other) = delete;
+  process& operator=(process const& other) = delete;
+
+  ~process()
+  {
+    for (auto ins : m_list) {
+      delete ins;
+    }
+  }
+
   void add_instruction(instruction* const& other) { m_list.push_back(other); }
 
   void set_process_label(label label) { m_process_label = label; }
 
-  label get_process_label() { return m_process_label; }
+  label const& get_process_label() const { return m_process_label; }
 
-  vector<instruction*> get_instruction_list() { return m_list; }
+  void set_index(int index) { m_index = index; }
+  int get_index() const { return m_index; }
+
+  vector<instruction*> const& get_instruction_list() const { return m_list; }
 
   void sync_process_label_across_instructions()
   {
@@ -57,7 +76,7 @@ public:
   {
     unordered_set<variable> ret;
     for (auto const& ins : m_list) {
-      if (ins->get_instruction_type() == mutex) {
+      if (ins->get_instruction_type() == instruction_type::mutex) {
         auto mut = dynamic_cast<mutex_instruction*>(ins);
         ret.insert(mut->get_mutex_var());
       }
@@ -76,25 +95,151 @@ public:
   }
 };
 
+// Dense integer ids for the shared variables, mutexes, processes and
+// instructions of a program. A state is a flat array of ints with the layout
+//   [ shared values | mutex owners (-1 if unlocked) | process pcs ]
+// and the slot helpers below map ids to positions in that array.
+class symbol_table
+{
+private:
+  vector<variable> m_shared_vars;
+  vector<variable> m_mutex_vars;
+  vector<process*> m_processes;
+  vector<instruction*> m_instructions;
+  unordered_map<variable, int> m_shared_ids;
+  unordered_map<variable, int> m_mutex_ids;
+  unordered_map<label, int> m_instruction_ids;
+  // [mutex id] processes with an instruction on the mutex
+  vector<process_set> m_lock_users;
+  process_set m_all_processes;
+  instruction_table m_table;
+
+  static int intern(variable const& v, vector<variable>& names, unordered_map<variable, int>& ids)
+  {
+    auto it = ids.find(v);
+    if (it != ids.end()) {
+      return it->second;
+    }
+    int id = names.size();
+    names.push_back(v);
+    ids.insert(make_pair(v, id));
+    return id;
+  }
+
+public:
+  int intern_shared_var(variable const& v) { return intern(v, m_shared_vars, m_shared_ids); }
+  int intern_mutex_var(variable const& v) { return intern(v, m_mutex_vars, m_mutex_ids); }
+  void add_lock_user(int mutex_id, int proc)
+  {
+    if (mutex_id >= (int) m_lock_users.size()) {
+      m_lock_users.resize(mutex_id + 1);
+    }
+    m_lock_users[mutex_id].insert(proc);
+  }
+  int add_process(process* const& proc)
+  {
+    m_processes.push_back(proc);
+    m_all_processes.insert(m_processes.size() - 1);
+    return m_processes.size() - 1;
+  }
+
+  int add_instruction(instruction* const& ins)
+  {
+    m_instructions.push_back(ins);
+    m_instruction_ids.insert(make_pair(ins->get_instruction_label(), m_instructions.size() - 1));
+    return m_instructions.size() - 1;
+  }
+
+  // id of the instruction with the given label, -1 if there is none
+  int find_instruction(label const& l) const
+  {
+    auto it = m_instruction_ids.find(l);
+    return it == m_instruction_ids.end() ? -1 : it->second;
+  }
+
+  int num_shared_vars() const { return m_shared_vars.size(); }
+  int num_mutex_vars() const { return m_mutex_vars.size(); }
+  int num_processes() const { return m_processes.size(); }
+  int num_instructions() const { return m_instructions.size(); }
+
+  variable const& shared_var_name(int id) const { return m_shared_vars[id]; }
+  variable const& mutex_var_name(int id) const { return m_mutex_vars[id]; }
+  process* get_process(int id) const { return m_processes[id]; }
+  instruction* get_instruction(int id) const { return m_instructions[id]; }
+  process_set const& get_lock_users(int mutex_id) const { return m_lock_users[mutex_id]; }
+  process_set const& get_all_processes() const { return m_all_processes; }
+  instruction_table const& get_table() const { return m_table; }
+
+  // Builds the instruction table, once all ids are assigned
+  void lower_instructions()
+  {
+    for (auto const& ins : m_instructions) {
+      m_table.add(ins);
+    }
+  }
+
+  int shared_slot(int id) const { return id; }
+  int mutex_slot(int id) const { return m_shared_vars.size() + id; }
+  int pc_slot(int id) const { return m_shared_vars.size() + m_mutex_vars.size() + id; }
+  // number of ints in a state
+  int width() const { return m_shared_vars.size() + m_mutex_vars.size() + m_processes.size(); }
+};
+
 class concurrent_procs
 {
 private:
   unordered_map<label, process*> m_procs;
   binary_label_relation m_program_order;
   binary_label_relation m_dependancy_relation;
+  symbol_table m_symbols;
+  // The relations below indexed by instruction id, filled in by
+  // compute_dependancy_relation() once symbols are interned:
+  // m_dependancy_relation (including program order, not symmetric)
+  bit_matrix m_dependancy_matrix;
+  // instruction_table::are_dependant()
+  bit_matrix m_conflict_matrix;
+  // instruction_table::may_be_coenabled()
+  bit_matrix m_coenabled_matrix;
+  // for every instruction b, the co-enabled instructions a of other
+  // processes for which is_dependant(a, b) only holds through program order
+  vector<vector<int>> m_order_dependants;
 
 public:
   concurrent_procs()
     : m_procs(), m_program_order()
   { }
 
-  unordered_map<label, process*> get_processes() { return m_procs; }
-  void set_program_order(binary_label_relation const& p) { m_program_order = p; }
-  binary_label_relation get_dependant_set() {return m_dependancy_relation; }
+  // the program owns its processes
+  concurrent_procs(concurrent_procs const& other) = delete;
+  concurrent_procs& operator=(concurrent_procs const& other) = delete;
+
+  ~concurrent_procs()
+  {
+    for (auto const& proc : m_procs) {
+      delete proc.second;
+    }
+  }
+
+  unordered_map<label, process*> const& get_processes() const { return m_procs; }
+  void add_program_order(label const& l1, label const& l2) { m_program_order.add_pair(l1, l2); }
+  binary_label_relation const& get_dependant_set() const { return m_dependancy_relation; }
+  bool is_dependant(int i1, int i2) const { return m_dependancy_matrix.test(i1, i2); }
+  bool is_conflicting(int i1, int i2) const { return m_conflict_matrix.test(i1, i2); }
+  bool is_coenabled(int i1, int i2) const { return m_coenabled_matrix.test(i1, i2); }
+  // shared variable written and read, lock acquired and released by an
+  // instruction, -1 if none
+  int get_written_var(int i) const { return m_symbols.get_table().written_var(i); }
+  int get_read_var(int i) const { return m_symbols.get_table().read_var(i); }
+  int get_acquired_lock(int i) const { return m_symbols.get_table().acquired_lock(i); }
+  int get_released_lock(int i) const { return m_symbols.get_table().released_lock(i); }
+  vector<int> const& get_order_dependants(int i) const { return m_order_dependants[i]; }
+  symbol_table const& get_symbols() const { return m_symbols; }
 
+  // Takes ownership of other
   void add_program(process* const& other)
   {
     if (m_procs.count(other->get_process_label())) {
+      delete other;
       throw "All processes should have unique labels";
     }
     m_procs.insert(make_pair(other->get_process_label(), other));
@@ -117,7 +262,9 @@ public:
   }
 
   void check_distinct_instruction_labels();
-  binary_label_relation compute_dependancy_relation();
+  void intern_symbols();
+  binary_label_relation const& compute_dependancy_relation();
+  void compute_instruction_matrices();
 };
 
 #endif
@@ -0,0 +1,149 @@
+#ifndef SPILL_TABLE_HPP
+#define SPILL_TABLE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+
+// Table of fixed-size records in a memory-mapped file, which holds the
+// visited states spilled out of memory. A record is stored at the index of
+// its state label, so the file is sparse: only the pages of spilled states
+// take disk space. The file is created in $TMPDIR (or /tmp) and unlinked
+// right away, so it goes away with the process. The mapping grows by
+// doubling the file.
+class spill_table
+{
+private:
+  int m_fd;
+  char* m_map;
+  size_t m_mapped;
+  size_t m_record_size;
+
+  void grow(size_t bytes);
+
+public:
+  // Throws a string literal if the file cannot be created
+  explicit spill_table(size_t record_size);
+  ~spill_table();
+
+  spill_table(spill_table const&) = delete;
+  spill_table& operator=(spill_table const&) = delete;
+
+  // Stores a record of record_size bytes at index
+  void put(long index, void const* record);
+  // Record at index, valid until the next put()
+  void const* at(long index) const { return m_map + index * m_record_size; }
+
+  size_t record_size() const { return m_record_size; }
+};
+
+// Visited-state index used with a spill_table. Like the table of
+// state_store it is probed linearly from the low bits of the hash of a
+// state, but a slot is a single word holding the upper 32 bits of the
+// hash and the label, so that the index stays small next to the states.
+// As the full hashes are not kept, growing the table asks for the hash of
+// every label again.
+class fingerprint_index
+{
+private:
+  // 0 for an empty slot, otherwise fingerprint << 32 | (label + 1)
+  vector<uint64_t> m_entries;
+  size_t m_mask;
+  int m_size;
+
+  // probe statistics, as in state_store
+  long m_lookups;
+  long m_probes;
+  long m_max_probe;
+  long m_collisions;
+
+  static uint64_t fingerprint(size_t h) { return h >> 32; }
+
+  template <typename Rehash>
+  void grow(Rehash const& hash_of);
+
+public:
+  fingerprint_index();
+
+  // Returns the label of the state of hash h for which equal(label) holds
+  // if there is one, otherwise gives the next label to the state and
+  // returns it. hash_of(label) is the hash of a stored state.
+  template <typename Equal, typename Rehash>
+  int find_or_insert(size_t h, Equal const& equal, Rehash const& hash_of);
+
+  int size() const { return m_size; }
+  long probes() const { return m_probes; }
+  size_t bytes() const { return m_entries.capacity() * sizeof(uint64_t); }
+
+  string dump_stats() const
+  {
+    stringstream ss;
+    ss << "STATE_INDEX_CAPACITY = " << m_entries.size() << "\n";
+    ss << "STATE_INDEX_LOOKUPS = " << m_lookups << "\n";
+    ss << "STATE_INDEX_AVG_PROBE = " << (m_lookups ? (double) m_probes / m_lookups : 0.0) << "\n";
+    ss << "STATE_INDEX_MAX_PROBE = " << m_max_probe << "\n";
+    ss << "STATE_INDEX_HASH_COLLISIONS = " << m_collisions << "\n";
+    return ss.str();
+  }
+};
+
+template <typename Equal, typename Rehash>
+int
+fingerprint_index::find_or_insert(size_t h, Equal const& equal, Rehash const& hash_of)
+{
+  uint64_t fp = fingerprint(h);
+  size_t pos = h & m_mask;
+  long probe = 1;
+
+  m_lookups++;
+  while (m_entries[pos]) {
+    if (m_entries[pos] >> 32 == fp) {
+      int candidate = (int) (uint32_t) m_entries[pos] - 1;
+      if (equal(candidate)) {
+        m_probes += probe;
+        m_max_probe = max(m_max_probe, probe);
+        return candidate;
+      }
+      m_collisions++;
+    }
+    pos = (pos + 1) & m_mask;
+    probe++;
+  }
+  m_probes += probe;
+  m_max_probe = max(m_max_probe, probe);
+
+  int ret = m_size++;
+  m_entries[pos] = fp << 32 | (uint32_t) (ret + 1);
+  // keep the load factor at or below one half
+  if (2 * (size_t) m_size > m_entries.size()) {
+    grow(hash_of);
+  }
+  return ret;
+}
+
+// Labels are placed in order, so that the hashes of spilled states are
+// read from the spill file front to back
+template <typename Rehash>
+void
+fingerprint_index::grow(Rehash const& hash_of)
+{
+  size_t capacity = m_entries.size() * 2;
+  vector<uint64_t>().swap(m_entries);
+  m_entries.assign(capacity, 0);
+  m_mask = capacity - 1;
+  for (int label = 0; label < m_size; ++label) {
+    size_t h = hash_of(label);
+    size_t pos = h & m_mask;
+    while (m_entries[pos]) {
+      pos = (pos + 1) & m_mask;
+    }
+    m_entries[pos] = fingerprint(h) << 32 | (uint32_t) (label + 1);
+  }
+}
+
+#endif
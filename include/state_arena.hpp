@@ -0,0 +1,52 @@
+#ifndef STATE_ARENA_HPP
+#define STATE_ARENA_HPP
+
+#include <vector>
+
+using namespace std;
+
+class state;
+class symbol_table;
+
+// Slab allocator for states. Every record holds a state object followed by
+// its flat slot array, so a state and its data live in one allocation.
+// Freed states go to a free list and are handed out again by allocate(),
+// and release() destroys all states and frees the slabs in one shot.
+class state_arena
+{
+private:
+  symbol_table const* m_symbols;
+  size_t m_record_size;
+  size_t m_records_per_slab;
+  vector<char*> m_slabs;
+  // records handed out from the last slab
+  size_t m_used;
+  vector<state*> m_free;
+
+  long m_allocated;
+  long m_recycled;
+
+public:
+  state_arena();
+  explicit state_arena(symbol_table const* symbols);
+  ~state_arena();
+
+  state_arena(state_arena const&) = delete;
+  state_arena& operator=(state_arena const&) = delete;
+
+  // Returns a state whose slots are uninitialized and whose
+  // backtrack, done and sleep sets are empty
+  state* allocate();
+  // Returns s to the free list, s must not be referenced afterwards
+  void free(state* s);
+  // Destroys every state handed out by this arena
+  void release();
+
+  // bytes of one state with its slots
+  size_t record_size() const { return m_record_size; }
+  long allocations() const { return m_allocated; }
+  long recycled() const { return m_recycled; }
+  size_t reserved_bytes() const { return m_slabs.size() * m_records_per_slab * m_record_size; }
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef STATE_STORE_HPP
+#define STATE_STORE_HPP
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+
+using namespace std;
+
+class state;
+
+// Visited-state index. States are kept in discovery order in m_states,
+// and an open-addressing (linear probing) table maps the structural hash
+// of a state to its position. Full equality is only checked on a hash match.
+class state_store
+{
+private:
+  vector<state*> m_states;
+  // parallel arrays forming the hash table; a slot is empty iff m_slots[i] < 0
+  vector<size_t> m_hashes;
+  vector<int> m_slots;
+  size_t m_mask;
+
+  // probe statistics
+  long m_lookups;
+  long m_probes;
+  long m_max_probe;
+  long m_collisions;
+
+  void grow();
+
+public:
+  state_store();
+
+  // Returns the stored state equal to s if there is one, otherwise
+  // appends s to the store and returns it
+  state* find_or_insert(state* const& s);
+  // Same as above with the hash of s already computed
+  state* find_or_insert(state* const& s, size_t h);
+  // Same as above with equal(candidate) deciding whether a stored state
+  // whose hash is h matches s
+  template <typename Equal>
+  state* find_or_insert(state* const& s, size_t h, Equal const& equal);
+
+  int size() const { return m_states.size(); }
+  size_t capacity() const { return m_slots.size(); }
+  long lookups() const { return m_lookups; }
+  long probes() const { return m_probes; }
+  long max_probe() const { return m_max_probe; }
+  long collisions() const { return m_collisions; }
+  state* at(int i) const { return m_states[i]; }
+  // Overwrites the probe statistics, when restoring a checkpoint
+  void restore_stats(long lookups, long probes, long max_probe, long collisions)
+  {
+    m_lookups = lookups;
+    m_probes = probes;
+    m_max_probe = max_probe;
+    m_collisions = collisions;
+  }
+  vector<state*> const& get_states() const { return m_states; }
+
+  string dump_stats() const
+  {
+    stringstream ss;
+    ss << "STATE_INDEX_CAPACITY = " << m_slots.size() << "\n";
+    ss << "STATE_INDEX_LOOKUPS = " << m_lookups << "\n";
+    ss << "STATE_INDEX_AVG_PROBE = " << (m_lookups ? (double) m_probes / m_lookups : 0.0) << "\n";
+    ss << "STATE_INDEX_MAX_PROBE = " << m_max_probe << "\n";
+    ss << "STATE_INDEX_HASH_COLLISIONS = " << m_collisions << "\n";
+    return ss.str();
+  }
+};
+
+template <typename Equal>
+state*
+state_store::find_or_insert(state* const& s, size_t h, Equal const& equal)
+{
+  size_t pos = h & m_mask;
+  long probe = 1;
+
+  m_lookups++;
+  while (m_slots[pos] >= 0) {
+    if (m_hashes[pos] == h) {
+      state* candidate = m_states[m_slots[pos]];
+      if (equal(candidate)) {
+        m_probes += probe;
+        m_max_probe = max(m_max_probe, probe);
+        return candidate;
+      }
+      m_collisions++;
+    }
+    pos = (pos + 1) & m_mask;
+    probe++;
+  }
+  m_probes += probe;
+  m_max_probe = max(m_max_probe, probe);
+
+  m_hashes[pos] = h;
+  m_slots[pos] = m_states.size();
+  m_states.push_back(s);
+
+  // keep the load factor at or below one half
+  if (2 * m_states.size() > m_slots.size()) {
+    grow();
+  }
+  return s;
+}
+
+// Visited-state index shared by parallel workers. States are spread over
+// independently locked state_store shards by the top bits of their hash,
+// and every inserted state is labelled with a fresh id under its shard lock,
+// so the label is valid before any other worker can find the state.
+class concurrent_state_store
+{
+private:
+  vector<state_store> m_shards;
+  vector<std::mutex> m_locks;
+  atomic<int> m_next_label;
+
+public:
+  concurrent_state_store(int num_shards = 64)
+    : m_shards(num_shards), m_locks(num_shards), m_next_label(0)
+  { }
+
+  state* find_or_insert(state* const& s);
+
+  int size() const { return m_next_label.load(); }
+  long probes() const;
+
+  string dump_stats() const;
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef SYMMETRY_HPP
+#define SYMMETRY_HPP
+
+#include <vector>
+#include <utility>
+#include <string>
+#include "program.hpp"
+
+using namespace std;
+
+// Process symmetry of a program. Two processes are symmetric if they run
+// the same instructions on the same variables and mutexes, and swapping
+// them maps the dependancy relation (program order included) onto itself.
+// States that only differ by a permutation of symmetric processes are
+// then equivalent, and the canonical form of a state, in which the pcs of
+// every class of symmetric processes are sorted and the mutex owners are
+// renamed accordingly, identifies its equivalence class.
+//
+// A process at a given pc holds the mutexes its instructions acquired and
+// did not release yet, so sorting the pcs also orders the lock owners.
+//
+// The scratch buffers make a symmetry object usable by one thread only.
+class symmetry
+{
+private:
+  symbol_table const* m_symbols;
+  // classes of at least two symmetric processes, in increasing id order
+  vector<vector<int>> m_classes;
+  // [proc] new id of the process in the canonical form
+  vector<int> m_rename;
+  vector<pair<int, int>> m_order;
+  // canonical forms of the state being looked up and of a candidate
+  vector<int> m_canonical;
+  vector<int> m_candidate;
+
+  void canonicalize(int const* slots, int* out);
+
+public:
+  symmetry(concurrent_procs const& program);
+
+  bool empty() const { return m_classes.empty(); }
+  int num_classes() const { return m_classes.size(); }
+  // processes that belong to some class
+  int num_symmetric_processes() const;
+
+  // Hash of the canonical form of slots, which is kept for equivalent()
+  size_t hash(int const* slots);
+  // Whether slots have the same canonical form as the last hashed slots
+  bool equivalent(int const* slots);
+
+  string dump_string() const;
+};
+
+#endif
@@ -11,6 +11,35 @@ inline void hash_combine(std::size_t & seed, const T & v)
     seed ^= hasher(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
 }
 
+// 64-bit finalizer (splitmix64) used to spread structured hash values
+inline std::size_t hash_mix(std::size_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Hash of a contiguous array of ints
+inline std::size_t hash_ints(const int* data, std::size_t n)
+{
+    std::size_t h = 0xcbf29ce484222325ULL ^ n;
+    for (std::size_t i = 0; i < n; ++i) {
+        h = (h ^ (unsigned int) data[i]) * 0x100000001b3ULL;
+    }
+    return hash_mix(h);
+}
+
+// Random-looking key of value in the given slot of a state. The hash of a
+// state is the XOR of the keys of its slots (Zobrist hashing), so changing
+// one slot updates it with two XORs.
+inline std::size_t zobrist_key(int slot, int value)
+{
+    return hash_mix(((std::size_t) slot << 32 | (unsigned int) value) + 0x9e3779b97f4a7c15ULL);
+}
+
 template<typename S, typename T>
 struct hash<pair<S, T>>
 {
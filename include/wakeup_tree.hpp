@@ -0,0 +1,92 @@
+#ifndef WAKEUP_TREE_HPP
+#define WAKEUP_TREE_HPP
+
+#include <vector>
+#include <utility>
+
+using namespace std;
+
+// Wakeup tree of optimal DPOR (Abdulla et al., POPL 2014): an ordered tree
+// of process sequences still to be explored from a state. Node 0 is the
+// root, the children of a node are kept in insertion order and the first
+// child is the next one to explore. Removed nodes are only unlinked, their
+// storage is reclaimed by clear().
+class wakeup_tree
+{
+private:
+  struct node
+  {
+    int m_proc;
+    int m_first_child;
+    int m_last_child;
+    int m_next_sibling;
+  };
+
+  vector<node> m_nodes;
+  vector<pair<int, int>> m_copy_stack;
+
+public:
+  wakeup_tree() { clear(); }
+
+  void clear()
+  {
+    m_nodes.clear();
+    m_nodes.push_back({ -1, -1, -1, -1 });
+  }
+
+  bool empty() const { return m_nodes[0].m_first_child < 0; }
+  int get_proc(int n) const { return m_nodes[n].m_proc; }
+  int first_child(int n) const { return m_nodes[n].m_first_child; }
+  int next_sibling(int n) const { return m_nodes[n].m_next_sibling; }
+  bool is_leaf(int n) const { return m_nodes[n].m_first_child < 0; }
+
+  // Appends a child for proc as the last child of n, returns the new node
+  int add_child(int n, int proc)
+  {
+    int child = m_nodes.size();
+    m_nodes.push_back({ proc, -1, -1, -1 });
+    if (m_nodes[n].m_last_child < 0) {
+      m_nodes[n].m_first_child = child;
+    } else {
+      m_nodes[m_nodes[n].m_last_child].m_next_sibling = child;
+    }
+    m_nodes[n].m_last_child = child;
+    return child;
+  }
+
+  // Drops the subtree below n, n itself stays as a leaf
+  void make_leaf(int n)
+  {
+    m_nodes[n].m_first_child = -1;
+    m_nodes[n].m_last_child = -1;
+  }
+
+  // Removes the first child of the root with its subtree
+  void remove_first()
+  {
+    node& root = m_nodes[0];
+    root.m_first_child = m_nodes[root.m_first_child].m_next_sibling;
+    if (root.m_first_child < 0) {
+      root.m_last_child = -1;
+    }
+  }
+
+  // Replaces this tree by the subtree below node n of other
+  void assign_subtree(wakeup_tree const& other, int n)
+  {
+    clear();
+    // (node of other, node of this tree) pairs whose children are copied
+    m_copy_stack.clear();
+    m_copy_stack.push_back(make_pair(n, 0));
+    while (!m_copy_stack.empty()) {
+      auto next = m_copy_stack.back();
+      m_copy_stack.pop_back();
+      for (int c = other.first_child(next.first); c >= 0; c = other.next_sibling(c)) {
+        int added = add_child(next.second, other.get_proc(c));
+        m_copy_stack.push_back(make_pair(c, added));
+      }
+    }
+  }
+};
+
+#endif
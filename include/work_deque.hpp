@@ -0,0 +1,55 @@
+#ifndef WORK_DEQUE_HPP
+#define WORK_DEQUE_HPP
+
+#include <deque>
+#include <mutex>
+
+using namespace std;
+
+// Per-worker task queue for work stealing. The owner pushes and pops at the
+// back (most recent, deepest work), thieves take from the front, which
+// holds the oldest and usually largest subtrees.
+template <typename T>
+class work_deque
+{
+private:
+  deque<T*> m_tasks;
+  mutable std::mutex m_lock;
+
+public:
+  void push(T* task)
+  {
+    lock_guard<std::mutex> lock(m_lock);
+    m_tasks.push_back(task);
+  }
+
+  T* pop()
+  {
+    lock_guard<std::mutex> lock(m_lock);
+    if (m_tasks.empty()) {
+      return NULL;
+    }
+    T* ret = m_tasks.back();
+    m_tasks.pop_back();
+    return ret;
+  }
+
+  T* steal()
+  {
+    lock_guard<std::mutex> lock(m_lock);
+    if (m_tasks.empty()) {
+      return NULL;
+    }
+    T* ret = m_tasks.front();
+    m_tasks.pop_front();
+    return ret;
+  }
+
+  bool empty() const
+  {
+    lock_guard<std::mutex> lock(m_lock);
+    return m_tasks.empty();
+  }
+};
+
+#endif
@@ -0,0 +1,180 @@
+#include "batch.hpp"
+#include "parse.tab.hpp"
+#include <stdio.h>
+#include <dirent.h>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+using namespace std;
+
+// reentrant scanner interface generated by flex
+int yylex_init_extra(parse_context* extra, yyscan_t* scanner);
+void yyset_in(FILE* file, yyscan_t scanner);
+int yylex_destroy(yyscan_t scanner);
+
+static long
+elapsed_us(chrono::steady_clock::time_point from, chrono::steady_clock::time_point to)
+{
+  return chrono::duration_cast<chrono::microseconds>(to - from).count();
+}
+
+concurrent_procs*
+parse_model(string const& filename)
+{
+  FILE* file = fopen(filename.c_str(), "r");
+  if (file == NULL) {
+    throw "Cannot open the input file";
+  }
+  parse_context ctx;
+  yyscan_t scanner;
+  if (yylex_init_extra(&ctx, &scanner)) {
+    fclose(file);
+    throw "Cannot initialize the scanner";
+  }
+  yyset_in(file, scanner);
+  int err;
+  try {
+    err = yyparse(scanner, &ctx);
+  } catch (...) {
+    yylex_destroy(scanner);
+    fclose(file);
+    throw;
+  }
+  yylex_destroy(scanner);
+  fclose(file);
+  if (err) {
+    throw "Error in parsing input";
+  }
+  concurrent_procs* ret = ctx.release_program();
+  try {
+    ret->check_distinct_instruction_labels();
+    ret->intern_symbols();
+  } catch (...) {
+    delete ret;
+    throw;
+  }
+  return ret;
+}
+
+vector<string>
+list_batch_models(string const& source)
+{
+  vector<string> ret;
+  DIR* dir = opendir(source.c_str());
+  if (dir != NULL) {
+    while (struct dirent* entry = readdir(dir)) {
+      string name = entry->d_name;
+      if (name.size() > 4 && name.compare(name.size() - 4, 4, ".txt") == 0) {
+        ret.push_back(source + "/" + name);
+      }
+    }
+    closedir(dir);
+    sort(ret.begin(), ret.end());
+    return ret;
+  }
+
+  ifstream manifest(source);
+  if (!manifest) {
+    throw "Cannot open the batch directory or manifest";
+  }
+  size_t slash = source.find_last_of('/');
+  string base = slash == string::npos ? "" : source.substr(0, slash + 1);
+  string line;
+  while (getline(manifest, line)) {
+    size_t begin = line.find_first_not_of(" \t\r");
+    if (begin == string::npos || line[begin] == '#') {
+      continue;
+    }
+    size_t end = line.find_last_not_of(" \t\r");
+    string path = line.substr(begin, end - begin + 1);
+    ret.push_back(path[0] == '/' ? path : base + path);
+  }
+  return ret;
+}
+
+static batch_result
+explore_model(string const& model, dpor_options const& options)
+{
+  batch_result ret;
+  ret.m_model = model;
+  try {
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    unique_ptr<concurrent_procs> program(parse_model(model));
+    chrono::steady_clock::time_point parsed_at = chrono::steady_clock::now();
+    program->compute_dependancy_relation();
+    chrono::steady_clock::time_point dependancy_at = chrono::steady_clock::now();
+    dpor algo(program.get(), model, "", options);
+    algo.dynamic_por();
+    chrono::steady_clock::time_point explored_at = chrono::steady_clock::now();
+
+    ret.m_parse_us = elapsed_us(begin, parsed_at);
+    ret.m_dependancy_us = elapsed_us(parsed_at, dependancy_at);
+    ret.m_explore_us = elapsed_us(dependancy_at, explored_at);
+    ret.m_states = algo.num_states();
+    ret.m_transitions = algo.num_transitions();
+    ret.m_executions = algo.num_executions();
+  } catch (char const* e) {
+    ret.m_error = e;
+  } catch (exception const& e) {
+    ret.m_error = e.what();
+  } catch (...) {
+    ret.m_error = "Unknown error";
+  }
+  return ret;
+}
+
+// Quotes s as a CSV field
+static string
+csv_field(string const& s)
+{
+  string ret = "\"";
+  for (char c : s) {
+    if (c == '"') {
+      ret += '"';
+    }
+    ret += c;
+  }
+  return ret + "\"";
+}
+
+int
+run_batch(vector<string> const& models, string const& results_file, int jobs,
+  dpor_options const& options)
+{
+  assert(!options.m_write_graph);
+  ofstream out(results_file);
+  if (!out) {
+    throw "Cannot open the batch results file for writing";
+  }
+
+  // every worker takes the next model until none is left
+  vector<batch_result> results(models.size());
+  atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < models.size(); i = next++) {
+      results[i] = explore_model(models[i], options);
+    }
+  };
+  vector<thread> workers;
+  for (int i = 1; i < jobs; ++i) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto& t : workers) {
+    t.join();
+  }
+
+  int failed = 0;
+  out << "model,status,parse_us,dependancy_us,explore_us,states,transitions,executions,error\n";
+  for (auto const& r : results) {
+    failed += !r.m_error.empty();
+    out << csv_field(r.m_model) << "," << (r.m_error.empty() ? "ok" : "error") << ","
+      << r.m_parse_us << "," << r.m_dependancy_us << "," << r.m_explore_us << ","
+      << r.m_states << "," << r.m_transitions << "," << r.m_executions << ","
+      << csv_field(r.m_error) << "\n";
+  }
+  return failed;
+}
@@ -0,0 +1,382 @@
+#include "checkpoint.hpp"
+#include "dpor.hpp"
+#include <stdio.h>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+
+using namespace std;
+
+uint64_t
+checkpoint_fingerprint(concurrent_procs const& program)
+{
+  auto const& symbols = program.get_symbols();
+  auto const& table = symbols.get_table();
+  int n = table.size();
+  vector<int> data;
+  data.push_back(symbols.num_shared_vars());
+  data.push_back(symbols.num_mutex_vars());
+  data.push_back(symbols.num_processes());
+  data.push_back(n);
+  for (int i = 0; i < n; ++i) {
+    data.push_back(table.get_opcode(i));
+    data.push_back(table.get_operand(i));
+    data.push_back(table.get_source(i));
+    data.push_back(table.get_process(i));
+  }
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      data.push_back(program.is_dependant(i, j));
+    }
+  }
+  return hash_ints(data.data(), data.size());
+}
+
+checkpoint_writer::checkpoint_writer(string const& file, double interval_seconds, uint32_t flags,
+  uint64_t fingerprint, int width, int set_words)
+  : m_file(file), m_interval_ms(max((long) (interval_seconds * 1000), 1L)),
+    m_due(false), m_stopping(false),
+    m_written(0), m_failed(0), m_bytes(0), m_max_capture_us(0), m_total_capture_us(0)
+{
+  memset(&m_header, 0, sizeof(m_header));
+  memcpy(m_header.m_magic, checkpoint_file_magic, sizeof(checkpoint_file_magic));
+  m_header.m_version = checkpoint_file_version;
+  m_header.m_flags = flags;
+  m_header.m_fingerprint = fingerprint;
+  m_header.m_width = width;
+  m_header.m_set_words = set_words;
+  m_thread = thread(&checkpoint_writer::run, this);
+}
+
+checkpoint_writer::~checkpoint_writer()
+{
+  finish();
+}
+
+void
+checkpoint_writer::restore(vector<state*> const& states, vector<uint64_t> const& sets)
+{
+  lock_guard<std::mutex> lock(m_lock);
+  m_states.assign(states.begin(), states.end());
+  m_sets = sets;
+}
+
+void
+checkpoint_writer::submit(unique_ptr<checkpoint_delta> delta, long capture_us)
+{
+  m_max_capture_us = max(m_max_capture_us, capture_us);
+  m_total_capture_us += capture_us;
+  lock_guard<std::mutex> lock(m_lock);
+  m_due = false;
+  m_pending = move(delta);
+  m_wake.notify_one();
+}
+
+void
+checkpoint_writer::finish()
+{
+  {
+    lock_guard<std::mutex> lock(m_lock);
+    if (m_stopping) {
+      return;
+    }
+    m_stopping = true;
+    m_wake.notify_one();
+  }
+  m_thread.join();
+}
+
+// Every interval, raises m_due and writes the delta submitted in reply.
+// A delta submitted before finish() is still written.
+void
+checkpoint_writer::run()
+{
+  unique_lock<std::mutex> lock(m_lock);
+  while (!m_stopping) {
+    if (m_wake.wait_for(lock, chrono::milliseconds(m_interval_ms), [this] { return m_stopping; })) {
+      break;
+    }
+    m_due = true;
+    m_wake.wait(lock, [this] { return m_pending || m_stopping; });
+    if (!m_pending) {
+      break;
+    }
+    unique_ptr<checkpoint_delta> delta = move(m_pending);
+    lock.unlock();
+    merge(*delta);
+    if (write_file()) {
+      m_written++;
+    } else {
+      m_failed++;
+    }
+    lock.lock();
+  }
+}
+
+void
+checkpoint_writer::merge(checkpoint_delta& delta)
+{
+  int words = 3 * m_header.m_set_words;
+  for (size_t i = 0; i < delta.m_dirty.size(); ++i) {
+    size_t label = delta.m_dirty[i];
+    if (label >= m_states.size()) {
+      m_states.resize(label + 1, NULL);
+      m_sets.resize(m_states.size() * words, 0);
+    }
+    m_states[label] = delta.m_dirty_states[i];
+    copy(&delta.m_dirty_words[i * words], &delta.m_dirty_words[(i + 1) * words],
+      &m_sets[(size_t) delta.m_dirty[i] * words]);
+  }
+  m_search.data().swap(delta.m_search.data());
+  // new states are all recorded, so there are no gaps
+  assert(find(m_states.begin(), m_states.end(), (state const*) NULL) == m_states.end());
+}
+
+bool
+checkpoint_writer::write_file()
+{
+  string temp = m_file + ".tmp";
+  ofstream out(temp, ios::binary);
+  if (!out) {
+    return false;
+  }
+  m_header.m_num_states = m_states.size();
+  m_header.m_search_bytes = m_search.size();
+  out.write((char const*) &m_header, sizeof(m_header));
+  for (auto s : m_states) {
+    out.write((char const*) s->get_slots(), m_header.m_width * sizeof(int));
+  }
+  out.write((char const*) m_sets.data(), m_sets.size() * sizeof(uint64_t));
+  out.write(m_search.data().data(), m_search.size());
+  out.close();
+  if (!out || rename(temp.c_str(), m_file.c_str()) != 0) {
+    return false;
+  }
+  m_bytes = sizeof(m_header) + m_states.size() * m_header.m_width * sizeof(int)
+    + m_sets.size() * sizeof(uint64_t) + m_search.size();
+  return true;
+}
+
+string
+checkpoint_writer::dump_stats() const
+{
+  stringstream ss;
+  ss << "CHECKPOINTS_WRITTEN = " << m_written << "\n";
+  ss << "CHECKPOINTS_FAILED = " << m_failed << "\n";
+  ss << "CHECKPOINT_BYTES = " << m_bytes << "\n";
+  ss << "CHECKPOINT_MAX_CAPTURE_US = " << m_max_capture_us << "\n";
+  ss << "CHECKPOINT_TOTAL_CAPTURE_US = " << m_total_capture_us << "\n";
+  return ss.str();
+}
+
+void
+read_checkpoint(string const& file, checkpoint_file_header& header,
+  vector<int>& slots, vector<uint64_t>& sets, checkpoint_buffer& search)
+{
+  ifstream in(file, ios::binary);
+  if (!in) {
+    throw "Cannot open the checkpoint file";
+  }
+  in.read((char*) &header, sizeof(header));
+  if (!in || memcmp(header.m_magic, checkpoint_file_magic, sizeof(checkpoint_file_magic)) != 0) {
+    throw "Not a checkpoint file";
+  }
+  if (header.m_version != checkpoint_file_version) {
+    throw "Unsupported checkpoint version";
+  }
+  slots.resize(header.m_num_states * header.m_width);
+  sets.resize(header.m_num_states * 3 * header.m_set_words);
+  search.data().resize(header.m_search_bytes);
+  in.read((char*) slots.data(), slots.size() * sizeof(int));
+  in.read((char*) sets.data(), sets.size() * sizeof(uint64_t));
+  in.read(search.data().data(), search.size());
+  if (!in) {
+    throw "The checkpoint is truncated";
+  }
+}
+
+// Records s and its sets in m_delta, over an earlier record of s if there
+// is one. Every stored state is entered, so it is recorded once it is left
+// or at the next checkpoint. States that are not stored are written with
+// the stack instead.
+void
+dpor::record_sets(state* s)
+{
+  int label = s->get_label();
+  if (m_stateless || m_states.at(label) != s) {
+    return;
+  }
+  if ((int) m_delta_index.size() <= label) {
+    m_delta_index.resize(max(label + 1, 2 * (int) m_delta_index.size()), -1);
+  }
+  // an index left over from an earlier delta is recognized by not
+  // pointing back to the label
+  auto& delta = *m_delta;
+  int words = num_set_words();
+  int& index = m_delta_index[label];
+  if (index < 0 || index >= (int) delta.m_dirty.size() || delta.m_dirty[index] != label) {
+    index = delta.m_dirty.size();
+    delta.m_dirty.push_back(label);
+    delta.m_dirty_states.push_back(s);
+    delta.m_dirty_words.resize(delta.m_dirty_words.size() + 3 * words);
+  }
+  uint64_t* w = &delta.m_dirty_words[(size_t) index * 3 * words];
+  for (int i = 0; i < words; ++i) {
+    w[i] = s->get_backtrack_set().get_word(i);
+    w[words + i] = s->get_done_set().get_word(i);
+    w[2 * words + i] = s->get_sleep_set().get_word(i);
+  }
+}
+
+// Hands the part of the exploration that changed since the last
+// checkpoint to the writer. Called between two steps of explore_frames,
+// where there is one frame per state of the stack. The states left since
+// the last checkpoint are already in m_delta, so the cost only depends on
+// the depth of the stack.
+void
+dpor::take_checkpoint(explore_context& ctx)
+{
+  chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+  assert(ctx.m_frames.size() == ctx.m_stack.size() + 1);
+  int width = m_data->get_symbols().width();
+  int words = num_set_words();
+  for (auto const& f : ctx.m_frames) {
+    record_sets(f.m_state);
+  }
+  unique_ptr<checkpoint_delta> delta = move(m_delta);
+  m_delta.reset(new checkpoint_delta());
+
+  auto& out = delta->m_search;
+  out.put<int64_t>(m_num_states);
+  out.put<int64_t>(m_symmetric_hits);
+  out.put<int64_t>(ctx.m_transitions);
+  out.put<int64_t>(ctx.m_executions);
+  out.put<int64_t>(m_states.lookups());
+  out.put<int64_t>(m_states.probes());
+  out.put<int64_t>(m_states.max_probe());
+  out.put<int64_t>(m_states.collisions());
+  out.put<int32_t>(ctx.m_stack.size());
+  for (auto const& t : ctx.m_stack) {
+    out.put<int32_t>(t.get_action());
+    out.put<int32_t>(t.get_process());
+  }
+  // a frame refers to its stored state by label, other states (all of
+  // them when stateless) are written out
+  for (auto const& f : ctx.m_frames) {
+    state* s = f.m_state;
+    out.put<int32_t>(f.m_clock_mark);
+    if (!m_stateless && m_states.at(s->get_label()) == s) {
+      out.put<int32_t>(s->get_label());
+      continue;
+    }
+    out.put<int32_t>(-1);
+    out.put<int32_t>(s->get_label());
+    out.put_array(s->get_slots(), width);
+    out.put_set(s->get_backtrack_set(), words);
+    out.put_set(s->get_done_set(), words);
+    out.put_set(s->get_sleep_set(), words);
+  }
+  ctx.m_clocks.save(out, ctx.m_stack.size());
+
+  long capture_us = chrono::duration_cast<chrono::microseconds>(
+    chrono::steady_clock::now() - begin).count();
+  m_checkpoint->submit(move(delta), capture_us);
+}
+
+// Rebuilds the store, the stack and the frames of ctx from the checkpoint
+// in m_resume_file, so that explore_frames continues where it was taken
+void
+dpor::restore_checkpoint(explore_context& ctx)
+{
+  assert(!m_graph);
+  checkpoint_file_header header;
+  vector<int> slots;
+  vector<uint64_t> sets;
+  checkpoint_buffer in;
+  read_checkpoint(m_resume_file, header, slots, sets, in);
+
+  auto const& symbols = m_data->get_symbols();
+  int width = symbols.width();
+  int words = num_set_words();
+  if (header.m_flags != checkpoint_flags()) {
+    throw "The checkpoint was taken with other options";
+  }
+  if (header.m_fingerprint != checkpoint_fingerprint(*m_data)
+    || (int) header.m_width != width || (int) header.m_set_words != words) {
+    throw "The checkpoint was taken of another model";
+  }
+
+  // stored states are inserted in their original order, which gives the
+  // same table layout
+  for (size_t i = 0; i < header.m_num_states; ++i) {
+    state* s = state::from_slots(symbols, ctx.m_arena, &slots[i * width]);
+    uint64_t const* w = &sets[i * 3 * words];
+    process_set backtrack, done, sleep;
+    for (int j = 0; j < words; ++j) {
+      backtrack.set_word(j, w[j]);
+      done.set_word(j, w[words + j]);
+      sleep.set_word(j, w[2 * words + j]);
+    }
+    s->set_backtrack_set(backtrack);
+    s->set_done_set(done);
+    s->set_sleep_set(sleep);
+    s->set_label(i);
+    m_states.find_or_insert(s, m_symmetry ? m_symmetry->hash(s->get_slots()) : s->hash());
+  }
+
+  m_num_states = in.get<int64_t>();
+  m_symmetric_hits = in.get<int64_t>();
+  ctx.m_transitions = in.get<int64_t>();
+  ctx.m_executions = in.get<int64_t>();
+  long lookups = in.get<int64_t>();
+  long probes = in.get<int64_t>();
+  long max_probe = in.get<int64_t>();
+  long collisions = in.get<int64_t>();
+  m_states.restore_stats(lookups, probes, max_probe, collisions);
+
+  int depth = in.get<int32_t>();
+  if (depth < 0 || (size_t) depth > in.size()) {
+    throw "The checkpoint is corrupted";
+  }
+  vector<pair<int, int>> moves(depth);
+  for (auto& m : moves) {
+    m.first = in.get<int32_t>();
+    m.second = in.get<int32_t>();
+    if (m.first < 0 || m.first >= symbols.num_instructions()) {
+      throw "The checkpoint is corrupted";
+    }
+  }
+  vector<int> buffer(width);
+  for (int d = 0; d <= depth; ++d) {
+    int mark = in.get<int32_t>();
+    int label = in.get<int32_t>();
+    state* s;
+    if (label >= 0) {
+      if (label >= m_states.size()) {
+        throw "The checkpoint is corrupted";
+      }
+      s = m_states.at(label);
+    } else {
+      label = in.get<int32_t>();
+      in.get_array(buffer.data(), width);
+      s = state::from_slots(symbols, ctx.m_arena, buffer.data());
+      s->set_label(label);
+      s->set_backtrack_set(in.get_set(words));
+      s->set_done_set(in.get_set(words));
+      s->set_sleep_set(in.get_set(words));
+    }
+    ctx.m_frames.push_back(explore_frame(s, mark));
+  }
+  m_start_state = ctx.m_frames[0].m_state;
+  for (int i = 0; i < depth; ++i) {
+    ctx.m_stack.push_back(transition(ctx.m_frames[i].m_state, moves[i].first, moves[i].second,
+      ctx.m_frames[i + 1].m_state));
+    push_access(ctx, i);
+  }
+  ctx.m_clocks.load(in, depth);
+
+  if (m_checkpoint) {
+    m_checkpoint->restore(m_states.get_states(), sets);
+    m_delta_index.assign(m_states.size(), -1);
+  }
+}
@@ -26,56 +26,46 @@ concurrent_procs::check_distinct_instruction_labels()
   }
 }
 
-bool
-are_instructions_dependant(instruction* i1, instruction* i2)
+// Assigns dense ids to all processes, shared variables and mutexes,
+// and records them on the processes and instructions
+void
+concurrent_procs::intern_symbols()
 {
-  if (i1 == NULL || i2 == NULL) {
-    return false;
-  }
-  if (i1->get_instruction_type() != i2->get_instruction_type()) {
-    return false;
-  }
-  if (i1->get_instruction_type() == assignment) {
-    auto a1 = dynamic_cast<assignment_instruction*>(i1);
-    auto a2 = dynamic_cast<assignment_instruction*>(i2);
-    assert(a1);
-    assert(a2);
-    return a1->are_dependant(a2);
-  } else {
-    auto a1 = dynamic_cast<mutex_instruction*>(i1);
-    auto a2 = dynamic_cast<mutex_instruction*>(i2);
-    assert(a1);
-    assert(a2);
-    return a1->are_dependant(a2);
-  }
-}
-
-bool
-may_be_coenabled(instruction* i1, instruction* i2)
-{ 
-  if (i1->get_process_id() == i2->get_process_id()) {
-    return false;
-  }
-  if (i1->get_instruction_type() == mutex) {
-    auto a1 = dynamic_cast<mutex_instruction*>(i1);
-    auto a2 = dynamic_cast<mutex_instruction*>(i2);
-    assert(a1);
-    assert(a2);
-    return !(a1->get_mutex_var() == a2->get_mutex_var()
-      && a1->is_acquire() != a2->is_acquire());
+  for (auto const& proc : m_procs) {
+    int index = m_symbols.add_process(proc.second);
+    proc.second->set_index(index);
+    for (auto const& ins : proc.second->get_instruction_list()) {
+      ins->set_process_index(index);
+      ins->set_index(m_symbols.add_instruction(ins));
+      if (ins->get_instruction_type() == assignment) {
+        auto assign = dynamic_cast<assignment_instruction*>(ins);
+        assert(assign);
+        int left = m_symbols.intern_shared_var(assign->get_lhs());
+        int right = -1;
+        if (!assign->is_constant_assignment()) {
+          right = m_symbols.intern_shared_var(assign->get_rhs_var());
+        }
+        assign->set_variable_ids(left, right);
+      } else {
+        auto mut = dynamic_cast<mutex_instruction*>(ins);
+        assert(mut);
+        mut->set_mutex_id(m_symbols.intern_mutex_var(mut->get_mutex_var()));
+        m_symbols.add_lock_user(mut->get_mutex_id(), index);
+      }
+    }
   }
-  return true;
+  m_symbols.lower_instructions();
 }
 
 binary_label_relation
-compute_dependant_instructions(process* p1, process* p2)
+compute_dependant_instructions(instruction_table const& table, process* p1, process* p2)
 {
   binary_label_relation ret;
   for (auto const& i1: p1->get_instruction_list()) {
     for (auto const& i2: p2->get_instruction_list()) {
-      if (are_instructions_dependant(i1, i2)) {
-        string l1 = i1->get_instruction_label();
-        string l2 = i2->get_instruction_label();
+      if (table.are_dependant(i1->get_index(), i2->get_index())) {
+        auto const& l1 = i1->get_instruction_label();
+        auto const& l2 = i2->get_instruction_label();
         ret.add_pair(l1, l2);
         ret.add_pair(l2, l1);
       }
@@ -85,7 +75,7 @@ compute_dependant_instructions(process* p1, process* p2)
   return ret;
 }
 
-binary_label_relation
+binary_label_relation const&
 concurrent_procs::compute_dependancy_relation()
 {
   if (m_dependancy_relation.size()) {
@@ -98,252 +88,602 @@ concurrent_procs::compute_dependancy_relation()
 
   int p = process_ids.size();
   for (int i = 0; i < p; ++i) {
-    string pid_i = process_ids[i];
+    auto const& pid_i = process_ids[i];
     for (int j = i + 1; j < p; ++j) {
-      string pid_j = process_ids[j];
-      auto Dij = compute_dependant_instructions(m_procs[pid_i], m_procs[pid_j]);
+      auto const& pid_j = process_ids[j];
+      auto Dij = compute_dependant_instructions(m_symbols.get_table(), m_procs[pid_i], m_procs[pid_j]);
       m_dependancy_relation.relation_union(Dij);
     }
   }
 
   m_dependancy_relation.relation_union(m_program_order);
+  compute_instruction_matrices();
 
   return m_dependancy_relation;
 }
 
-instruction*
-state::get_process_next_transition(process* const& proc)
+// Precomputes the dependancy relation, instruction_table::are_dependant()
+// and instruction_table::may_be_coenabled() over instruction ids, so that the exploration only
+// does bit tests
+void
+concurrent_procs::compute_instruction_matrices()
 {
-  int pc = m_loc_state[proc->get_process_label()];
-  if (pc >= proc->get_instruction_list().size()) {
-    return NULL;
-  } else {
-    return proc->get_instruction_list()[pc];
+  int n = m_symbols.num_instructions();
+  m_dependancy_matrix = bit_matrix(n);
+  m_conflict_matrix = bit_matrix(n);
+  m_coenabled_matrix = bit_matrix(n);
+
+  for (auto const& p : m_dependancy_relation.get_pairs()) {
+    int i1 = m_symbols.find_instruction(p.first);
+    int i2 = m_symbols.find_instruction(p.second);
+    if (i1 >= 0 && i2 >= 0) {
+      m_dependancy_matrix.set(i1, i2);
+    }
   }
-}
 
-unordered_set<process*>
-state::get_enabled_set(unordered_map<label, process*> const& all_procs)
-{
-  unordered_set<process*> ret;
-  for (auto const& p : all_procs) {
-    auto ins = get_process_next_transition(p.second);
-    if (ins == NULL) {
-      continue;
+  auto const& table = m_symbols.get_table();
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      if (table.are_dependant(i, j)) {
+        m_conflict_matrix.set(i, j);
+      }
+      if (table.may_be_coenabled(i, j)) {
+        m_coenabled_matrix.set(i, j);
+      }
     }
-    // A mutex instruction may get blocked
-    if (ins->get_instruction_type() == mutex) {
-      auto mut = dynamic_cast<mutex_instruction*>(ins);
-      assert(mut);
-      auto status = m_mutex_state[mut->get_mutex_var()];
-      if (status.first == locked) {
-        if (status.second != p.first) {
-          // Another process cannot operate on a lock owned by a different process
-          continue;
-        } else if (mut->is_acquire()) {
-          // cannot call acquire on an already acquired lock
-          continue;
-        }
-      } else {
-        // cannot call release on an unlocked mutex
-        if (!mut->is_acquire()) {
-          continue;
-        }
+  }
+
+  m_order_dependants.assign(n, vector<int>());
+  for (int b = 0; b < n; ++b) {
+    for (int a = 0; a < n; ++a) {
+      if (m_dependancy_matrix.test(a, b) && !m_conflict_matrix.test(a, b)
+        && m_coenabled_matrix.test(a, b)) {
+        m_order_dependants[b].push_back(a);
       }
     }
-    ret.insert(p.second);
   }
+}
 
-  return ret;
+int
+state::get_next_instruction(int proc) const
+{
+  return m_symbols->get_table().at(proc, get_pc(proc));
 }
 
-// Assume that the instruction is enabled at the current state
-state*
-state::get_next_state(instruction* const& ins)
+bool
+state::is_enabled(int proc) const
 {
-  assert(ins);
-  state* next = new state(*this);
-  if (ins->get_instruction_type() == mutex) {
-    auto mut = dynamic_cast<mutex_instruction*>(ins);
-    assert(mut);
-    auto status = next->m_mutex_state[mut->get_mutex_var()];
-    if (status.first == locked) {
-      assert(status.second == mut->get_process_id());
-      assert(!mut->is_acquire());
-      next->m_mutex_state[mut->get_mutex_var()] = make_pair(unlocked, "");
-    } else {
-      assert(mut->is_acquire());
-      next->m_mutex_state[mut->get_mutex_var()] = make_pair(locked, mut->get_process_id());
+  auto const& table = m_symbols->get_table();
+  int ins = get_next_instruction(proc);
+  if (ins < 0) {
+    return false;
+  }
+  // A mutex instruction may get blocked: an acquire needs an unlocked
+  // mutex and a release one owned by proc
+  switch (table.get_opcode(ins)) {
+  case op_acquire:
+    return get_mutex_owner(table.get_operand(ins)) < 0;
+  case op_release:
+    return get_mutex_owner(table.get_operand(ins)) == proc;
+  default:
+    return true;
+  }
+}
+
+void
+state::compute_enabled_set()
+{
+  m_enabled.clear();
+  for (int p = 0; p < m_symbols->num_processes(); ++p) {
+    if (is_enabled(p)) {
+      m_enabled.insert(p);
     }
+  }
+}
+
+void
+state::update_enabled(int proc)
+{
+  if (is_enabled(proc)) {
+    m_enabled.insert(proc);
   } else {
-    auto assign = dynamic_cast<assignment_instruction*>(ins);
-    assert(assign);
-    if (assign->is_constant_assignment()) {
-      next->m_shared_state[assign->get_lhs()] = assign->get_rhs_val();
-    } else {
-      int read_val = next->m_shared_state.at(assign->get_rhs_var());
-      next->m_shared_state[assign->get_lhs()] = read_val;
-    }
+    m_enabled.erase(proc);
+  }
+}
+
+// Assume that the instruction is enabled at the current state
+state*
+state::get_next_state(int ins, state_arena& arena)
+{
+  auto const& table = m_symbols->get_table();
+  assert(ins >= 0 && ins < table.size());
+  state* next = arena.allocate();
+  next->m_label = 0;
+  next->m_sleep_set = m_symbols->get_all_processes();
+  memcpy(next->m_slots, m_slots, width() * sizeof(int));
+  next->m_hash = m_hash;
+  int proc = table.get_process(ins);
+  int operand = table.get_operand(ins);
+  switch (table.get_opcode(ins)) {
+  case op_assign_const:
+    next->set_slot(m_symbols->shared_slot(operand), table.get_source(ins));
+    break;
+  case op_assign_var:
+    next->set_slot(m_symbols->shared_slot(operand), get_shared_value(table.get_source(ins)));
+    break;
+  case op_acquire:
+    assert(get_mutex_owner(operand) < 0);
+    next->set_slot(m_symbols->mutex_slot(operand), proc);
+    break;
+  case op_release:
+    assert(get_mutex_owner(operand) == proc);
+    next->set_slot(m_symbols->mutex_slot(operand), -1);
+    break;
   }
   // Increment the pc of the executing process
-  next->m_loc_state[ins->get_process_id()]++;
+  next->set_slot(m_symbols->pc_slot(proc), get_pc(proc) + 1);
   // next->m_label = this->m_label + "." + ins->get_instruction_label();
 
+  // Only the moving process and, for a mutex operation, the processes
+  // using the same mutex can change from enabled to disabled or back
+  next->m_enabled = m_enabled;
+  next->update_enabled(proc);
+  if (table.is_mutex(ins)) {
+    auto const& users = m_symbols->get_lock_users(operand);
+    for (int q = users.first(); q >= 0; q = users.next(q)) {
+      next->update_enabled(q);
+    }
+  }
+
   return next;
 }
 
 state*
-dpor::find_state(state* const& s)
+dpor::find_state(explore_context& ctx, state* const& s)
 {
-  for (auto const& state : m_states) {
-    if (*state == *s) {
-      return state;
+  DPOR_TIME(ctx, time_find_state);
+  DPOR_COUNT(ctx, count_find_state_lookups);
+  if (m_stateless) {
+    s->set_label(m_num_states++);
+    if (m_graph) {
+      m_graph->add_state(s->get_label());
+    }
+    return s;
+  }
+  if (m_num_threads > 1) {
+    auto found = m_shared_states.find_or_insert(s);
+    if (found != s) {
+      DPOR_COUNT(ctx, count_find_state_hits);
+      ctx.m_arena.free(s);
+    } else if (m_graph) {
+      m_graph->add_state(s->get_label());
     }
+    return found;
+  }
+
+  state* found;
+  if (m_spill) {
+    found = find_or_unspill(ctx, s);
+  } else if (m_symmetry) {
+    size_t h = m_symmetry->hash(s->get_slots());
+    found = m_states.find_or_insert(s, h, [this](state* candidate) {
+      return m_symmetry->equivalent(candidate->get_slots());
+    });
+  } else {
+    found = m_states.find_or_insert(s);
+  }
+  if (m_symmetry && found != s && !(*found == *s)) {
+    // s is a permutation of found. The stack refers to the process ids
+    // of s, so it stays on the stack itself; with a full done set no
+    // transition is taken from it, but the races of the instructions
+    // left are still detected.
+    DPOR_COUNT(ctx, count_find_state_hits);
+    m_symmetric_hits++;
+    s->set_label(found->get_label());
+    s->set_done_set(m_data->get_symbols().get_all_processes());
+    return s;
+  }
+  if (found != s) {
+    // duplicates go straight back to the arena
+    DPOR_COUNT(ctx, count_find_state_hits);
+    ctx.m_arena.free(s);
+    return found;
+  }
+  s->set_label(num_states()-1);
+  m_resident++;
+  if (m_graph) {
+    m_graph->add_state(s->get_label());
   }
-  m_states.push_back(s);
-  s->set_label(to_string(m_states.size()-1));
   return s;
 }
 
+// Iterative DFS from the state at the top of the stack of ctx. Frames for
+// the states below it are kept in ctx.m_frames, so the depth of the
+// exploration is only bounded by memory.
 void
-dpor::explore(vector<transition> &stack, clock_vectors C)
+dpor::explore(explore_context& ctx)
 {
-  auto last_state = this->last_transition_sequence_state(stack);
-  
-  for (auto const& p : m_data->get_processes()) {
-    auto next_s_p = last_state->get_process_next_transition(p.second);
-    if (next_s_p == NULL) {
-      continue;
+  int entry_depth = ctx.m_stack.size();
+
+  if (!enter_state(ctx)) {
+    leave_state(ctx, entry_depth);
+    return;
+  }
+  explore_frames(ctx, entry_depth);
+}
+
+// Runs the DFS until the frames above entry_depth are left. The top frame
+// is for the state at the top of the stack, and has been entered.
+void
+dpor::explore_frames(explore_context& ctx, int entry_depth)
+{
+  auto& frames = ctx.m_frames;
+  while ((int) frames.size() > entry_depth) {
+    if (m_checkpoint && m_checkpoint->due()) {
+      take_checkpoint(ctx);
     }
-    bool found = false;
-    int index;
-    for (int i = stack.size() - 1; i >= 0; i--) {
-      auto ins = stack[i].get_action();
-      if (m_data->get_dependant_set().exists(ins->get_instruction_label(), next_s_p->get_instruction_label())
-        && may_be_coenabled(ins, next_s_p) && i + 1 > C.get_clock_vector(p.first)[ins->get_process_id()]) {
-        found = true;
-        index = i;
-        break;
+    // undo the process clocks set by the transition to the last child
+    ctx.m_clocks.rollback(frames.back().m_clock_mark);
+    auto last_state = frames.back().m_state;
+    // first process of backtrack \ (done U sleep). The processes taken
+    // from last_state before p sleep after it.
+    process_set sleep;
+    int p;
+    {
+      auto lock = lock_state(last_state);
+      sleep = last_state->get_sleep_set();
+      sleep.set_union(last_state->get_done_set());
+      p = last_state->get_backtrack_set().first_not_in(sleep);
+      if (p >= 0) {
+        last_state->add_to_done_set(p);
+      } else {
+        process_set asleep = last_state->get_backtrack_set();
+        asleep.set_difference(last_state->get_done_set());
+        DPOR_COUNT_N(ctx, count_sleep_prunes, asleep.size());
       }
     }
-    if (found) {
-      auto ins = stack[index].get_action();
-      auto pre_s_i = stack[index].get_from_state();
-      auto enabled_set = pre_s_i->get_enabled_set(m_data->get_processes());
-      if (enabled_set.count(p.second)) {
-        // cout << "On state " << last_state->get_label() << ", Adding " << p.first << " to backtrack set of " << pre_s_i->get_label() << endl;
-        pre_s_i->add_to_backtrack_set(p.second);
-        pre_s_i->add_to_sleep_set(m_data->get_processes()[ins->get_process_id()]);
-        // cout << "Adding " << ins->get_process_id() << " to sleep set of " << pre_s_i->get_label() << endl;
+    if (p < 0) {
+      leave_state(ctx, entry_depth);
+      continue;
+    }
+    // cout << "At state " << last_state->get_label() << ", chosen proc = " << m_data->get_symbols().get_process(p)->get_process_label() << endl;
+    if (m_bitstate && m_bitstate->test_and_set(hash_mix(last_state->hash() + p))) {
+      // taken from this state before, as far as the bits tell
+      continue;
+    }
+    if (should_spawn(ctx)) {
+      spawn_task(ctx, ctx.m_stack.size(), p, sleep);
+      continue;
+    }
+    detect_races(ctx, p, last_state->get_next_instruction(p), true);
+    push_transition(ctx, last_state, p, sleep);
+    if (!enter_state(ctx)) {
+      leave_state(ctx, entry_depth);
+    }
+  }
+}
+
+// Records the accesses of the transition at position pos of the stack
+void
+dpor::push_access(explore_context& ctx, int pos)
+{
+  auto const& t = ctx.m_stack[pos];
+  int i = t.get_action();
+  ctx.m_accesses.push(pos, t.get_process(), i, m_data->get_written_var(i),
+    m_data->get_read_var(i), m_data->get_acquired_lock(i));
+}
+
+// Adds backtrack points for the races between the transitions on the
+// stack of ctx and b, an instruction of p. As in Source-DPOR
+// (resources/popl2014.pdf), it is called for the transitions taken only,
+// and every race that is not hidden by a later one is reversed: with
+// sleep sets, reversing the last race alone may lose executions. taken
+// tells b is taken right after the stack, otherwise it is one of the
+// transitions that may follow a revisited state.
+void
+dpor::detect_races(explore_context& ctx, int p, int b, bool taken)
+{
+  DPOR_TIME(ctx, time_race_detection);
+  auto& stack = ctx.m_stack;
+  auto& C = ctx.m_clocks;
+  auto const& A = ctx.m_accesses;
+  auto const& symbols = m_data->get_symbols();
+  auto& races = ctx.m_races;
+  // The transition of q racing with b, if any, is the last one of q
+  // dependant with it, if that one does not happen before p. Earlier
+  // transitions of q never qualify when the last one does not.
+  int const* clock = C.get_clock_vector(p);
+  int written = m_data->get_written_var(b);
+  int read = m_data->get_read_var(b);
+  int acquired = m_data->get_acquired_lock(b);
+  fill(races.begin(), races.end(), -1);
+  for (int q = 0; q < symbols.num_processes(); ++q) {
+    if (q == p) {
+      continue;
+    }
+    DPOR_COUNT(ctx, count_race_iterations);
+    int i = max(A.last_write(written, q), A.last_read(written, q));
+    i = max(i, A.last_write(read, q));
+    i = max(i, A.last_acquire(acquired, q));
+    if (i >= 0 && i + 1 > clock[q]) {
+      races[q] = i;
+    }
+  }
+  for (int a : m_data->get_order_dependants(b)) {
+    int i = A.position(a);
+    int q = i >= 0 ? stack[i].get_process() : -1;
+    if (i >= 0 && i + 1 > clock[q]) {
+      races[q] = max(races[q], i);
+    }
+  }
+  // a race is hidden when its transition happens before a later one
+  for (int q = 0; q < symbols.num_processes(); ++q) {
+    int i = races[q];
+    if (i < 0) {
+      continue;
+    }
+    bool hidden = false;
+    for (int r = 0; r < symbols.num_processes() && !hidden; ++r) {
+      int j = races[r];
+      hidden = j > i && C.transition_clock_vector(j + 1)[q] >= i + 1;
+    }
+    if (!hidden) {
+      reverse_race(ctx, i, p, b, taken);
+    }
+  }
+}
+
+// Adds to the backtrack set of the state before stack[index] an initial
+// of the sequence reversing the race of that transition with b, an
+// instruction of p: the transitions after index that do not happen after
+// it, then b. One initial is enough, so nothing is added if the backtrack
+// set has one already. If b is not taken right after the stack, the
+// transitions before it below the top state are not known, so if none
+// of the stack is an initial, every process that may start them is added.
+void
+dpor::reverse_race(explore_context& ctx, int index, int p, int b, bool taken)
+{
+  auto& stack = ctx.m_stack;
+  auto& C = ctx.m_clocks;
+  auto& first = ctx.m_reversal_first;
+  int ins_proc = stack[index].get_process();
+  // first[r] is the position of the first transition of r in the sequence
+  fill(first.begin(), first.end(), -1);
+  process_set initials, moved;
+  bool b_initial = taken;
+  for (int j = index + 1; j < (int) stack.size(); ++j) {
+    int const* cv = C.transition_clock_vector(j + 1);
+    int r = stack[j].get_process();
+    moved.insert(r);
+    if (cv[ins_proc] >= index + 1) {
+      continue;
+    }
+    if (m_data->is_dependant(stack[j].get_action(), b)) {
+      b_initial = false;
+    }
+    if (first[r] >= 0) {
+      continue;
+    }
+    // the first transition of r is an initial if no transition before it
+    // in the sequence happens before it
+    bool initial = true;
+    for (int q = 0; q < C.size() && initial; ++q) {
+      initial = first[q] < 0 || cv[q] < first[q] + 1;
+    }
+    first[r] = j;
+    if (initial) {
+      initials.insert(r);
+    }
+  }
+  int const* clock = C.get_clock_vector(p);
+  for (int q = 0; q < C.size() && b_initial; ++q) {
+    b_initial = first[q] < 0 || clock[q] < first[q] + 1;
+  }
+  if (b_initial) {
+    initials.insert(p);
+  }
+
+  auto pre_s_i = stack[index].get_from_state();
+  DPOR_COUNT(ctx, count_enabled_set_calls);
+  auto const& enabled_set = pre_s_i->get_enabled_set();
+  process_set claimed, sleep;
+  {
+    auto lock = lock_state(pre_s_i);
+    process_set before = pre_s_i->get_backtrack_set();
+    process_set known = initials;
+    known.set_intersection(before);
+    if (initials.empty() && !taken) {
+      // the processes that have not moved since index
+      initials = enabled_set;
+      initials.set_difference(moved);
+      initials.erase(ins_proc);
+      pre_s_i->add_to_backtrack_set(initials.empty() ? enabled_set : initials);
+    } else if (known.empty()) {
+      initials.set_intersection(enabled_set);
+      if (!initials.empty()) {
+        pre_s_i->add_to_backtrack_set(initials.first());
       } else {
-        for (auto const& en : enabled_set) {
-          pre_s_i->add_to_backtrack_set(en);
-        }
+        // every initial waits for a lock held there
+        pre_s_i->add_to_backtrack_set(enabled_set);
       }
     }
+    DPOR_COUNT_N(ctx, count_backtrack_insertions, pre_s_i->get_backtrack_set().size() - before.size());
+    if (index < ctx.m_base) {
+      // No frame on this worker will revisit an inherited stack entry,
+      // so new backtrack points there are claimed and spawned here
+      sleep = pre_s_i->get_sleep_set();
+      sleep.set_union(pre_s_i->get_done_set());
+      claimed = pre_s_i->get_backtrack_set();
+      claimed.set_difference(sleep);
+      pre_s_i->add_to_done_set(claimed);
+    }
+  }
+  for (int q = claimed.first(); q >= 0; q = claimed.next(q)) {
+    spawn_task(ctx, index, q, sleep);
+    sleep.insert(q);
   }
+}
 
-  auto enabled_set = last_state->get_enabled_set(m_data->get_processes());
-  unordered_set_difference(enabled_set, last_state->get_sleep_set());
+// Adds backtrack points for the races of the transitions below s, the
+// state at the top of the stack of ctx, which are not taken again since
+// s was visited before: any instruction left to a process may race with
+// the stack.
+void
+dpor::detect_cached_races(explore_context& ctx, state* s)
+{
+  auto const& table = m_data->get_symbols().get_table();
+  for (int p = 0; p < ctx.m_clocks.size(); ++p) {
+    int pc = s->get_pc(p);
+    for (int b = table.at(p, pc); b >= 0; b = table.at(p, ++pc)) {
+      detect_races(ctx, p, b, false);
+    }
+  }
+}
 
-  if (enabled_set.size()) {
-    auto proc = *enabled_set.begin();
-    unordered_set<process*> bs;
-    bs.insert(proc);
-    last_state->set_backtrack_set(bs);
-    unordered_set<process*> done, sleep;
+// Pushes the frame of the state at the top of the stack and seeds its
+// backtrack set. Returns false if no process can be
+// explored from it, in which case the execution is complete.
+bool
+dpor::enter_state(explore_context& ctx)
+{
+  auto& stack = ctx.m_stack;
+  auto& C = ctx.m_clocks;
+  auto last_state = this->last_transition_sequence_state(stack);
+  ctx.m_frames.push_back(explore_frame(last_state, C.mark()));
 
-    while (true) {
-      bs = last_state->get_backtrack_set();
-      done = last_state->get_done_set();
-      sleep = last_state->get_sleep_set();
-      // cout << "done Set at " << last_state->get_label() << endl;
-      // for (auto const& sleep_proc : done) {
-      //   cout << "\t" << sleep_proc->get_process_label() << endl;
-      // }
-      // cout << "sleep Set at " << last_state->get_label() << endl;
-      // for (auto const& sleep_proc : sleep) {
-      //   cout << "\t" << sleep_proc->get_process_label() << endl;
-      // }
-      unordered_set_difference(bs, done);
-      if (!bs.size()) {
-        break;
-      }
-      auto proc = *bs.begin();
-      // cout <<  "Chosen Process from enable set at " << last_state->get_label() << " = " << proc->get_process_label() << endl;
-      // cout << "BackTrack set size " <<  bs.size() << endl;
-      // cout << "At state " << last_state->get_label() << ", chosen proc = " << proc->get_process_label() << endl;
-      last_state->add_to_done_set(proc);
-      if (sleep.count(proc)) {
-        continue;
-      }
-      auto next_s_p = last_state->get_process_next_transition(proc);
-      auto empty_cv = C.empty_clock_vector();
-      for (int i = 0; i < stack.size(); ++i) {
-        auto ins = stack[i].get_action();
-        if (m_data->get_dependant_set().exists(ins->get_instruction_label(), next_s_p->get_instruction_label())) {
-          empty_cv = C.clock_vector_max(empty_cv, C.get_clock_vector(i+1));
-        }
-      }
-      auto next_state = last_state->get_next_state(next_s_p);
-      next_state = find_state(next_state);
-      for (auto const& sleep_proc : sleep) {
-        auto ins = last_state->get_process_next_transition(sleep_proc);
-        if (are_instructions_dependant(ins, next_s_p)) {
-          continue;
-        }
-        // cout << "Adding " << sleep_proc->get_process_label() << " to sleep set of " << next_state->get_label() << endl;
-        next_state->add_to_sleep_set(sleep_proc);
-      }
-      transition new_transition(last_state, next_s_p, next_state);
-      m_transitions.push_back(new_transition);
-      stack.push_back(new_transition);
-      empty_cv[proc->get_process_label()] = stack.size();
-      C.set_clock_vector(proc->get_process_label(), empty_cv);
-      C.set_clock_vector(stack.size(), empty_cv);
-      explore(stack, C);
-      stack.pop_back();
+  DPOR_COUNT(ctx, count_enabled_set_calls);
+  auto enabled_set = last_state->get_enabled_set();
+  {
+    auto lock = lock_state(last_state);
+    enabled_set.set_difference(last_state->get_sleep_set());
+    if (!enabled_set.empty()) {
+      // the done set of a revisited state already covers its earlier
+      // backtrack points, so adding to the set is the same as resetting it
+      last_state->add_to_backtrack_set(enabled_set.first());
     }
-  } else {
-    m_executions++;
   }
 
+  if (enabled_set.empty()) {
+    ctx.m_executions++;
+    return false;
+  }
+  return true;
 }
 
+// Pops the top frame. Process clocks set on its level are undone, and the
+// transition leading to it is popped unless explore was started there. In
+// stateless mode, and for a permutation of a visited state, the state of
+// the frame is not referenced anymore and goes back to the arena.
 void
-dpor::dynamic_por()
-{ 
-  vector<label> ids;
-  for (auto const& p : m_data->get_processes()) {
-    ids.push_back(p.first);
-  }
-  clock_vectors C(ids);
-  this->initialize_with_start_state();
-  vector<transition> stack;
-  explore(stack, C);
+dpor::leave_state(explore_context& ctx, int entry_depth)
+{
+  ctx.m_clocks.rollback(ctx.m_frames.back().m_clock_mark);
+  state* s = ctx.m_frames.back().m_state;
+  if (m_checkpoint) {
+    record_sets(s);
+  }
+  if (m_stateless || (m_symmetry && stored_state(s->get_label()) != s)) {
+    // not referenced by the state store
+    ctx.m_arena.free(s);
+  }
+  ctx.m_frames.pop_back();
+  if ((int) ctx.m_stack.size() > entry_depth) {
+    ctx.m_stack.pop_back();
+    ctx.m_accesses.pop();
+  }
 }
 
+// Executes proc at last_state, the top of the stack of ctx, and pushes
+// the resulting transition
 void
-dpor::print_to_dot_format()
+dpor::push_transition(explore_context& ctx, state* last_state, int p, process_set const& sleep)
 {
-  ofstream out(m_dot_file);
+  auto& stack = ctx.m_stack;
+  auto& C = ctx.m_clocks;
 
-  out << "digraph{\n";
-  out << "\tnodesep = 0.5;\n";
-  out << "\tranksep = 0.35;\n";
-
-  for (int i = 0; i < m_states.size(); ++i) {
-    out << "\t" << i;
-    out << "\n";
+  int next_s_p = last_state->get_next_instruction(p);
+  int depth = stack.size() + 1;
+  int* cv = C.transition_clock_vector(depth);
+  fill(cv, cv + C.size(), 0);
+  for (int i = 0; i < (int) stack.size(); ++i) {
+    if (m_data->is_dependant(stack[i].get_action(), next_s_p)) {
+      DPOR_COUNT(ctx, count_clock_joins);
+      C.clock_vector_max(cv, C.transition_clock_vector(i+1));
+    }
   }
-  // out << "\tsubgraph dir\n";
-  // out << "\t{\n";
+  state* next_state;
+  {
+    DPOR_TIME(ctx, time_next_state);
+    next_state = last_state->get_next_state(next_s_p, ctx.m_arena);
+  }
+  state* found = find_state(ctx, next_state);
+  process_set asleep;
+  for (int q = sleep.first(); q >= 0; q = sleep.next(q)) {
+    int ins = last_state->get_next_instruction(q);
+    if (ins >= 0 && m_data->is_conflicting(ins, next_s_p)) {
+      continue;
+    }
+    // cout << "Adding " << q << " to sleep set of " << next_state->get_label() << endl;
+    asleep.insert(q);
+  }
+  bool cached;
+  {
+    // A process stays asleep at a revisited state only if it was on
+    // every visit. Below the state, the states pruned by the processes
+    // woken up may be reached now, so its transitions are taken again.
+    auto lock = lock_state(found);
+    process_set was = found->get_sleep_set();
+    found->restrict_sleep_set(asleep);
+    if (found != next_state && !(found->get_sleep_set() == was)) {
+      found->set_done_set(process_set());
+    }
+    // another worker may be exploring a state it has taken nothing from yet
+    cached = !found->get_done_set().empty() || (m_num_threads > 1 && found != next_state);
+  }
+  next_state = found;
+  transition new_transition(last_state, next_s_p, p, next_state);
+  ctx.m_transitions++;
+  if (m_graph) {
+    m_graph->add_transition(last_state->get_label(), next_s_p, next_state->get_label());
+  }
+  stack.push_back(new_transition);
+  push_access(ctx, stack.size() - 1);
+  cv[p] = depth;
+  C.set_clock_vector(p, cv);
+  if (cached) {
+    detect_cached_races(ctx, next_state);
+  }
+}
 
-  for (auto const& t : m_transitions) {
-    out << "\t" << t.get_from_state()->get_label() << " -> " << t.get_to_state()->get_label() << " [label=\"" << t.get_action()->dump_string() << "\"];\n";
+void
+dpor::dynamic_por()
+{ 
+  if (m_mem_limit > 0) {
+    m_spill.reset(new spill_table(spill_record_size()));
+  }
+  if (!m_resume_file.empty()) {
+    assert(!m_optimal && m_num_threads == 1);
+    restore_checkpoint(*m_contexts[0]);
+    explore_frames(*m_contexts[0], 0);
+  } else {
+    this->initialize_with_start_state();
+    if (m_optimal) {
+      optimal_por();
+    } else if (m_num_threads > 1) {
+      parallel_por();
+    } else {
+      explore(*m_contexts[0]);
+    }
+  }
+  if (m_checkpoint) {
+    m_checkpoint->finish();
   }
+}
 
-  // out << "\t}\n";
-  out << "}";
-  out.close();
-}
\ No newline at end of file
+void
+dpor::close_graph()
+{
+  if (m_graph) {
+    m_graph->close();
+  }
+}
@@ -0,0 +1,159 @@
+#include "graph_writer.hpp"
+#include "program.hpp"
+#include <string.h>
+
+using namespace std;
+
+static const size_t flush_bytes = 1 << 20;
+
+dot_graph_writer::dot_graph_writer(string const& file, symbol_table const& symbols, bool shared)
+  : m_out(file), m_shared(shared), m_closed(false)
+{
+  if (!m_out) {
+    throw "Cannot open the graph output file for writing";
+  }
+  for (int i = 0; i < symbols.num_instructions(); ++i) {
+    m_action_labels.push_back(symbols.get_instruction(i)->dump_string());
+  }
+  m_buffer.reserve(flush_bytes + 256);
+  m_buffer += "digraph{\n";
+  m_buffer += "\tnodesep = 0.5;\n";
+  m_buffer += "\tranksep = 0.35;\n";
+}
+
+dot_graph_writer::~dot_graph_writer()
+{
+  close();
+}
+
+void
+dot_graph_writer::flush_if_full()
+{
+  if (m_buffer.size() >= flush_bytes) {
+    m_out.write(m_buffer.data(), m_buffer.size());
+    m_buffer.clear();
+  }
+}
+
+void
+dot_graph_writer::add_state(int label)
+{
+  unique_lock<std::mutex> lock;
+  if (m_shared) {
+    lock = unique_lock<std::mutex>(m_lock);
+  }
+  m_buffer += '\t';
+  m_buffer += to_string(label);
+  m_buffer += '\n';
+  flush_if_full();
+}
+
+void
+dot_graph_writer::add_transition(int from, int action, int to)
+{
+  unique_lock<std::mutex> lock;
+  if (m_shared) {
+    lock = unique_lock<std::mutex>(m_lock);
+  }
+  m_buffer += '\t';
+  m_buffer += to_string(from);
+  m_buffer += " -> ";
+  m_buffer += to_string(to);
+  m_buffer += " [label=\"";
+  m_buffer += m_action_labels[action];
+  m_buffer += "\"];\n";
+  flush_if_full();
+}
+
+void
+dot_graph_writer::close()
+{
+  if (m_closed) {
+    return;
+  }
+  m_closed = true;
+  m_buffer += "}";
+  m_out.write(m_buffer.data(), m_buffer.size());
+  m_buffer.clear();
+  m_out.close();
+}
+
+static const size_t edges_per_flush = flush_bytes / sizeof(graph_edge);
+
+binary_graph_writer::binary_graph_writer(string const& file, symbol_table const& symbols, bool shared)
+  : m_out(file, ios::binary), m_shared(shared), m_closed(false)
+{
+  if (!m_out) {
+    throw "Cannot open the graph output file for writing";
+  }
+  memset(&m_header, 0, sizeof(m_header));
+  memcpy(m_header.m_magic, graph_file_magic, sizeof(m_header.m_magic));
+  m_header.m_version = graph_file_version;
+  m_header.m_num_actions = symbols.num_instructions();
+  m_header.m_actions_offset = sizeof(m_header);
+  m_out.write((char const*) &m_header, sizeof(m_header));
+
+  uint64_t offset = m_header.m_actions_offset;
+  for (int i = 0; i < symbols.num_instructions(); ++i) {
+    string label = symbols.get_instruction(i)->dump_string();
+    uint32_t length = label.size();
+    label.resize((length + 3) / 4 * 4, '\0');
+    m_out.write((char const*) &length, sizeof(length));
+    m_out.write(label.data(), label.size());
+    offset += sizeof(length) + label.size();
+  }
+  m_header.m_edges_offset = offset;
+  m_buffer.reserve(edges_per_flush);
+}
+
+binary_graph_writer::~binary_graph_writer()
+{
+  close();
+}
+
+void
+binary_graph_writer::flush_edges()
+{
+  m_out.write((char const*) m_buffer.data(), m_buffer.size() * sizeof(graph_edge));
+  m_header.m_num_edges += m_buffer.size();
+  m_buffer.clear();
+}
+
+void
+binary_graph_writer::add_state(int label)
+{
+  unique_lock<std::mutex> lock;
+  if (m_shared) {
+    lock = unique_lock<std::mutex>(m_lock);
+  }
+  m_states.push_back(label);
+}
+
+void
+binary_graph_writer::add_transition(int from, int action, int to)
+{
+  unique_lock<std::mutex> lock;
+  if (m_shared) {
+    lock = unique_lock<std::mutex>(m_lock);
+  }
+  m_buffer.push_back({ from, action, to });
+  if (m_buffer.size() >= edges_per_flush) {
+    flush_edges();
+  }
+}
+
+void
+binary_graph_writer::close()
+{
+  if (m_closed) {
+    return;
+  }
+  m_closed = true;
+  flush_edges();
+  m_header.m_states_offset = m_header.m_edges_offset + m_header.m_num_edges * sizeof(graph_edge);
+  m_header.m_num_states = m_states.size();
+  m_out.write((char const*) m_states.data(), m_states.size() * sizeof(int32_t));
+  m_out.seekp(0);
+  m_out.write((char const*) &m_header, sizeof(m_header));
+  m_out.close();
+}
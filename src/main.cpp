@@ -3,41 +3,226 @@
 #include <string>
 #include <chrono>
 #include "dpor.hpp"
-#include "parse.tab.hpp"
-
-extern "C" int yylex();
-int yyparse();
-extern "C" FILE *yyin;
-extern "C" concurrent_procs* parsed;
+#include "batch.hpp"
 
 using namespace std;
 
+static long
+elapsed_us(chrono::steady_clock::time_point from, chrono::steady_clock::time_point to)
+{
+  return chrono::duration_cast<chrono::microseconds>(to - from).count();
+}
+
+static void
+usage(char const* prog)
+{
+  cout << "Usage: " << prog << " [--threads N] [--stateless | --optimal [--compare] | --symmetry] [--mem-limit MB] [--bitstate MB [--bitstate-hashes K]] [--no-graph | --binary] <input.txt> [<output>]" << endl;
+  cout << "       " << prog << " [--stateless | --symmetry] [--checkpoint FILE [--checkpoint-interval SECONDS]] [--resume FILE] --no-graph <input.txt>" << endl;
+  cout << "       " << prog << " --batch [--jobs N] [--threads N] [--stateless | --optimal] <directory | manifest> <results.csv>" << endl;
+}
+
 int
 main(int argc, char **argv)
 { 
-  if (argc <= 2) {
-    cout << "Insufficient number of Input Parameters. Expected = 3. Found = " << argc << endl;
+  dpor_options options;
+  bool compare = false;
+  bool batch = false;
+  int jobs = 1;
+  vector<char const*> files;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      options.m_num_threads = atoi(argv[++i]);
+      if (options.m_num_threads < 1) {
+        cout << "Number of threads should be positive" << endl;
+        return 1;
+      }
+    } else if (arg == "--jobs" && i + 1 < argc) {
+      jobs = atoi(argv[++i]);
+      if (jobs < 1) {
+        cout << "Number of jobs should be positive" << endl;
+        return 1;
+      }
+    } else if (arg == "--checkpoint" && i + 1 < argc) {
+      options.m_checkpoint_file = argv[++i];
+    } else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+      options.m_checkpoint_interval = atof(argv[++i]);
+      if (options.m_checkpoint_interval <= 0) {
+        cout << "Checkpoint interval should be positive" << endl;
+        return 1;
+      }
+    } else if (arg == "--resume" && i + 1 < argc) {
+      options.m_resume_file = argv[++i];
+    } else if (arg == "--mem-limit" && i + 1 < argc) {
+      options.m_mem_limit = (long) (atof(argv[++i]) * (1 << 20));
+      if (options.m_mem_limit <= 0) {
+        cout << "Memory limit should be positive" << endl;
+        return 1;
+      }
+    } else if (arg == "--bitstate" && i + 1 < argc) {
+      options.m_bitstate_bytes = (long) (atof(argv[++i]) * (1 << 20));
+      if (options.m_bitstate_bytes <= 0) {
+        cout << "Bitstate size should be positive" << endl;
+        return 1;
+      }
+    } else if (arg == "--bitstate-hashes" && i + 1 < argc) {
+      options.m_bitstate_hashes = atoi(argv[++i]);
+      if (options.m_bitstate_hashes < 1) {
+        cout << "Number of bitstate hashes should be positive" << endl;
+        return 1;
+      }
+    } else if (arg == "--batch") {
+      batch = true;
+    } else if (arg == "--no-graph") {
+      options.m_write_graph = false;
+    } else if (arg == "--optimal") {
+      options.m_optimal = true;
+    } else if (arg == "--compare") {
+      compare = true;
+    } else if (arg == "--stateless") {
+      options.m_stateless = true;
+    } else if (arg == "--symmetry") {
+      options.m_symmetry = true;
+    } else if (arg == "--binary") {
+      options.m_binary_graph = true;
+    } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+      cout << "Unknown option " << arg << endl;
+      usage(argv[0]);
+      return 1;
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+  if ((options.m_stateless || options.m_optimal) && options.m_num_threads > 1) {
+    cout << "--stateless and --optimal run on a single thread" << endl;
+    return 1;
+  }
+  if (options.m_symmetry && (options.m_stateless || options.m_optimal || options.m_num_threads > 1)) {
+    cout << "--symmetry needs the single-threaded search with state caching" << endl;
+    return 1;
+  }
+  bool checkpointing = !options.m_checkpoint_file.empty() || !options.m_resume_file.empty();
+  if (checkpointing && (options.m_optimal || options.m_num_threads > 1 || batch)) {
+    cout << "--checkpoint and --resume need the single-threaded classic engine" << endl;
+    return 1;
+  }
+  if (!options.m_resume_file.empty() && options.m_write_graph) {
+    cout << "--resume cannot write the graph, use --no-graph" << endl;
+    return 1;
+  }
+  if (options.m_mem_limit && (options.m_stateless || options.m_optimal || options.m_num_threads > 1)) {
+    cout << "--mem-limit needs the single-threaded search with state caching" << endl;
+    return 1;
+  }
+  if (options.m_mem_limit && checkpointing) {
+    cout << "--mem-limit cannot be combined with --checkpoint or --resume" << endl;
+    return 1;
+  }
+  if (options.m_bitstate_bytes && (options.m_optimal || options.m_num_threads > 1)) {
+    cout << "--bitstate needs the single-threaded classic engine" << endl;
+    return 1;
+  }
+  if (options.m_bitstate_bytes && (options.m_stateless || options.m_symmetry || options.m_mem_limit || checkpointing)) {
+    cout << "--bitstate cannot be combined with --stateless, --symmetry, --mem-limit, --checkpoint or --resume" << endl;
+    return 1;
+  }
+  if (compare && !options.m_optimal) {
+    cout << "--compare needs --optimal" << endl;
+    return 1;
+  }
+  if (batch) {
+    if (files.size() != 2 || compare) {
+      usage(argv[0]);
+      return 1;
+    }
+    // models are only counted, not drawn
+    options.m_write_graph = false;
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    vector<string> models;
+    int failed;
+    try {
+      models = list_batch_models(files[0]);
+      failed = run_batch(models, files[1], jobs, options);
+    } catch (char const* e) {
+      cout << e << endl;
+      return 1;
+    }
+    cout << "BATCH_MODELS = " << models.size() << "\n";
+    cout << "BATCH_FAILED = " << failed << "\n";
+    cout << "BATCH_US = " << elapsed_us(begin, chrono::steady_clock::now()) << endl;
+    return failed ? 2 : 0;
+  }
+  if (!options.m_write_graph && files.size() == 1) {
+    files.push_back("");
+  }
+  if (files.size() < 2) {
+    cout << "Insufficient number of Input Parameters. Expected = 3. Found = " << files.size() + 1 << endl;
+    usage(argv[0]);
     return 1; 
   }
+  // phases are timed separately, printing the parsed program is not timed
   chrono::steady_clock::time_point begin = chrono::steady_clock::now();
-  char const *filename = argv[1];
-  yyin = fopen(filename, "r");
-  assert(yyin);
-  int ret = yyparse();
-  if (ret) {
-    cout << "Error in parsing input" << endl;
+  char const *filename = files[0];
+  concurrent_procs* parsed;
+  try {
+    parsed = parse_model(filename);
+  } catch (char const* e) {
+    cout << e << endl;
     return 1;
   }
-  assert(parsed);
-  parsed->check_distinct_instruction_labels();
+  chrono::steady_clock::time_point parsed_at = chrono::steady_clock::now();
   parsed->compute_dependancy_relation();
+  chrono::steady_clock::time_point dependancy_at = chrono::steady_clock::now();
   cout << parsed->dump_string() << endl;
-  dpor algo(parsed, filename, argv[2]);
-  algo.dynamic_por();
+
+  chrono::steady_clock::time_point explore_begin = chrono::steady_clock::now();
+  dpor algo(parsed, filename, files[1], options);
+#ifdef DPOR_PROFILE
+  long allocations_before = profile_heap_allocations();
+#endif
+  try {
+    algo.dynamic_por();
+  } catch (char const* e) {
+    cout << e << endl;
+    return 1;
+  }
+#ifdef DPOR_PROFILE
+  long explore_allocations = profile_heap_allocations() - allocations_before;
+#endif
+  chrono::steady_clock::time_point explored_at = chrono::steady_clock::now();
+  algo.close_graph();
   chrono::steady_clock::time_point end = chrono::steady_clock::now();
-  cout << "Time difference = " << chrono::duration_cast<chrono::microseconds> (end - begin).count() << "[µs]" << std::endl;
+
+  long parse_us = elapsed_us(begin, parsed_at);
+  long dependancy_us = elapsed_us(parsed_at, dependancy_at);
+  long explore_us = elapsed_us(explore_begin, explored_at);
+  long output_us = elapsed_us(explored_at, end);
+  long total_us = parse_us + dependancy_us + explore_us + output_us;
+  cout << "Time difference = " << total_us << "[µs]" << std::endl;
+  cout << "PHASE_PARSE_US = " << parse_us << "\n";
+  cout << "PHASE_DEPENDANCY_US = " << dependancy_us << "\n";
+  cout << "PHASE_EXPLORE_US = " << explore_us << "\n";
+  cout << "PHASE_OUTPUT_US = " << output_us << "\n";
+  cout << algo.get_rates(explore_us);
   cout << algo.get_stats() << endl;
-  algo.print_to_dot_format();
+  if (compare) {
+    // the optimal engine is stateless, so compare with the classic engine
+    // without state caching, whose executions are all complete
+    dpor_options classic_options = options;
+    classic_options.m_optimal = false;
+    classic_options.m_stateless = true;
+    classic_options.m_write_graph = false;
+    dpor classic(parsed, filename, "", classic_options);
+    classic.dynamic_por();
+    long optimal_executions = algo.num_executions();
+    long classic_executions = classic.num_executions();
+    cout << "CLASSIC_EXECUTIONS = " << classic_executions << "\n";
+    cout << "CLASSIC_STATES = " << classic.num_states() << "\n";
+    cout << "EXECUTION_REDUCTION = " << (double) classic_executions / max(optimal_executions, 1L) << endl;
+  }
+#ifdef DPOR_PROFILE
+  cout << "PROFILE = " << algo.get_profile(explore_allocations) << endl;
+#endif
 
   return 0;
 }
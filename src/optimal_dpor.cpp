@@ -0,0 +1,346 @@
+#include "dpor.hpp"
+
+using namespace std;
+
+// Optimal DPOR with sleep sets and wakeup trees, Algorithm 2 of Abdulla et
+// al., "Optimal Dynamic Partial Order Reduction" (resources/popl2014.pdf).
+// It explores exactly one execution per Mazurkiewicz trace. The search is
+// stateless and iterative: m_frames holds the sleep set and wakeup tree of
+// every prefix of the current execution, and the races of a complete
+// execution are reversed by inserting wakeup sequences into the trees of
+// the prefixes they start from.
+//
+// Happens-before orders events of a process, and events of different
+// processes whose instructions are in m_hb_dependancy. That is the
+// dependancy relation plus release/acquire of the same lock, which keeps
+// an acquire behind the release it waited for, so that every wakeup
+// sequence stays executable. A release never races with the following
+// acquire since the two cannot be co-enabled; the acquires of the two
+// critical sections race instead, if nothing but that release orders them.
+
+void
+dpor::optimal_init()
+{
+  auto const& symbols = m_data->get_symbols();
+  m_optimal_ctx.reset(new optimal_context());
+  auto& opt = *m_optimal_ctx;
+
+  int n = symbols.num_instructions();
+  opt.m_hb_dependancy = bit_matrix(n);
+  opt.m_acquired_lock.assign(n, -1);
+  opt.m_released_lock.assign(n, -1);
+  for (int i = 0; i < n; ++i) {
+    opt.m_acquired_lock[i] = m_data->get_acquired_lock(i);
+    opt.m_released_lock[i] = m_data->get_released_lock(i);
+  }
+  auto const& table = symbols.get_table();
+  for (int i = 0; i < n; ++i) {
+    int lock_i = max(opt.m_acquired_lock[i], opt.m_released_lock[i]);
+    for (int j = 0; j < n; ++j) {
+      if (table.get_process(i) == table.get_process(j)) {
+        continue;
+      }
+      int lock_j = max(opt.m_acquired_lock[j], opt.m_released_lock[j]);
+      if (m_data->is_dependant(i, j) || m_data->is_dependant(j, i)
+        || (lock_i >= 0 && lock_i == lock_j)) {
+        opt.m_hb_dependancy.set(i, j);
+      }
+    }
+  }
+
+  opt.m_proc_instructions.resize(symbols.num_processes());
+  for (int p = 0; p < symbols.num_processes(); ++p) {
+    for (int pc = 0; table.at(p, pc) >= 0; ++pc) {
+      opt.m_proc_instructions[p].push_back(table.at(p, pc));
+    }
+  }
+  opt.m_last_event.assign(symbols.num_processes(), -1);
+  opt.m_pcs.resize(symbols.num_processes());
+  opt.m_lock_clock.resize(symbols.num_processes());
+}
+
+void
+dpor::optimal_push_frame(state* s, process_set const& sleep)
+{
+  auto& opt = *m_optimal_ctx;
+  if ((int) opt.m_frames.size() == opt.m_depth) {
+    opt.m_frames.emplace_back();
+  }
+  auto& f = opt.m_frames[opt.m_depth++];
+  f.m_state = s;
+  f.m_sleep = sleep;
+  f.m_wut.clear();
+  f.m_proc = -1;
+}
+
+// Pops the last frame and the event leading to it; the state is freed
+void
+dpor::optimal_pop_frame()
+{
+  auto& opt = *m_optimal_ctx;
+  m_contexts[0]->m_arena.free(opt.m_frames[--opt.m_depth].m_state);
+  if (opt.m_events.size() > 0 && (int) opt.m_events.size() == opt.m_depth) {
+    auto const& ev = opt.m_events.back();
+    opt.m_last_event[ev.m_proc] = ev.m_prev;
+    opt.m_races.resize(ev.m_race_mark);
+    opt.m_events.pop_back();
+  }
+}
+
+// Appends the event of proc executing ins, computes its clock vector and
+// records its races with the earlier events
+void
+dpor::optimal_push_event(int proc, int ins)
+{
+  auto& ctx = *m_contexts[0];
+  DPOR_TIME(ctx, time_race_detection);
+  auto& opt = *m_optimal_ctx;
+  auto& C = ctx.m_clocks;
+  int pos = opt.m_events.size();
+
+  optimal_event ev;
+  ev.m_proc = proc;
+  ev.m_ins = ins;
+  ev.m_prev = opt.m_last_event[proc];
+  ev.m_seq = ev.m_prev >= 0 ? opt.m_events[ev.m_prev].m_seq + 1 : 1;
+  ev.m_race_mark = opt.m_races.size();
+
+  int* cv = C.transition_clock_vector(pos + 1);
+  if (ev.m_prev >= 0) {
+    int const* prev = C.transition_clock_vector(ev.m_prev + 1);
+    copy(prev, prev + C.size(), cv);
+  } else {
+    fill(cv, cv + C.size(), 0);
+  }
+  cv[proc] = ev.m_seq;
+
+  // For an acquire, lock_cv is the clock without the last release of the
+  // lock by another process, to find the acquire that release ended
+  int lock = opt.m_acquired_lock[ins];
+  int* lock_cv = opt.m_lock_clock.data();
+  int release_proc = -1;
+  bool lock_seen = false, matched = false;
+  if (lock >= 0) {
+    copy(cv, cv + C.size(), lock_cv);
+  }
+
+  // Walking backwards, an event is a direct predecessor iff it is not
+  // already below the clock accumulated from the later events
+  for (int j = pos - 1; j >= 0; --j) {
+    DPOR_COUNT(ctx, count_race_iterations);
+    auto const& other = opt.m_events[j];
+    if (other.m_proc == proc || !opt.m_hb_dependancy.test(other.m_ins, ins)) {
+      continue;
+    }
+    int const* row = C.transition_clock_vector(j + 1);
+    if (other.m_seq > cv[other.m_proc]) {
+      DPOR_COUNT(ctx, count_clock_joins);
+      if ((m_data->is_dependant(other.m_ins, ins) || m_data->is_dependant(ins, other.m_ins))
+        && m_data->is_coenabled(other.m_ins, ins)) {
+        opt.m_races.push_back(make_pair(j, pos));
+      }
+      C.clock_vector_max(cv, row);
+    }
+    if (lock < 0) {
+      continue;
+    }
+    bool on_lock = opt.m_acquired_lock[other.m_ins] == lock || opt.m_released_lock[other.m_ins] == lock;
+    if (on_lock && !lock_seen) {
+      lock_seen = true;
+      if (opt.m_released_lock[other.m_ins] == lock) {
+        release_proc = other.m_proc;
+        continue;
+      }
+    }
+    if (!matched && other.m_proc == release_proc && opt.m_acquired_lock[other.m_ins] == lock) {
+      matched = true;
+      if (other.m_seq > lock_cv[other.m_proc]) {
+        opt.m_races.push_back(make_pair(j, pos));
+      }
+    }
+    if (other.m_seq > lock_cv[other.m_proc]) {
+      DPOR_COUNT(ctx, count_clock_joins);
+      C.clock_vector_max(lock_cv, row);
+    }
+  }
+
+  opt.m_last_event[proc] = pos;
+  opt.m_events.push_back(ev);
+}
+
+// Whether proc is a weak initial of m_sequence after the prefix whose
+// process counters are m_pcs: either its first event in the sequence has
+// no dependant event before it, or proc does not occur in the sequence and
+// its next instruction is independent of all of it
+bool
+dpor::optimal_weak_initial(int proc)
+{
+  auto const& opt = *m_optimal_ctx;
+  auto const& seq = opt.m_sequence;
+  int ins = -1;
+  size_t end = seq.size();
+  for (size_t k = 0; k < seq.size(); ++k) {
+    if (seq[k].first == proc) {
+      ins = seq[k].second;
+      end = k;
+      break;
+    }
+  }
+  if (ins < 0) {
+    auto const& list = opt.m_proc_instructions[proc];
+    if (opt.m_pcs[proc] >= (int) list.size()) {
+      return false;
+    }
+    ins = list[opt.m_pcs[proc]];
+  }
+  for (size_t j = 0; j < end; ++j) {
+    if (opt.m_hb_dependancy.test(seq[j].second, ins)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Inserts m_sequence into the wakeup tree of the prefix of length depth,
+// unless a process of its sleep set or an existing leaf already covers it
+void
+dpor::optimal_insert(int depth)
+{
+  auto& opt = *m_optimal_ctx;
+  auto& f = opt.m_frames[depth];
+  for (int p = 0; p < (int) opt.m_pcs.size(); ++p) {
+    opt.m_pcs[p] = f.m_state->get_pc(p);
+  }
+  for (int q = f.m_sleep.first(); q >= 0; q = f.m_sleep.next(q)) {
+    if (optimal_weak_initial(q)) {
+      return;
+    }
+  }
+
+  auto& wut = f.m_wut;
+  auto& seq = opt.m_sequence;
+  int node = 0;
+  while (!seq.empty()) {
+    if (node != 0 && wut.is_leaf(node)) {
+      return;
+    }
+    int next = -1;
+    for (int c = wut.first_child(node); c >= 0; c = wut.next_sibling(c)) {
+      if (optimal_weak_initial(wut.get_proc(c))) {
+        next = c;
+        break;
+      }
+    }
+    if (next < 0) {
+      for (auto const& ev : seq) {
+        node = wut.add_child(node, ev.first);
+      }
+      DPOR_COUNT_N(*m_contexts[0], count_backtrack_insertions, seq.size());
+      opt.m_insertions++;
+      return;
+    }
+    int p = wut.get_proc(next);
+    for (size_t k = 0; k < seq.size(); ++k) {
+      if (seq[k].first == p) {
+        seq.erase(seq.begin() + k);
+        break;
+      }
+    }
+    opt.m_pcs[p]++;
+    node = next;
+  }
+}
+
+// Called at a complete execution: for every race e < e', the sequence of
+// the events after e that do not happen after it, followed by e', reverses
+// the race from the state before e
+void
+dpor::optimal_race_reversals()
+{
+  auto& opt = *m_optimal_ctx;
+  auto& C = m_contexts[0]->m_clocks;
+  int n = opt.m_events.size();
+  for (auto const& race : opt.m_races) {
+    auto const& e = opt.m_events[race.first];
+    opt.m_sequence.clear();
+    for (int k = race.first + 1; k < n; ++k) {
+      if (C.transition_clock_vector(k + 1)[e.m_proc] < e.m_seq) {
+        opt.m_sequence.push_back(make_pair(opt.m_events[k].m_proc, opt.m_events[k].m_ins));
+      }
+    }
+    auto const& e2 = opt.m_events[race.second];
+    opt.m_sequence.push_back(make_pair(e2.m_proc, e2.m_ins));
+    optimal_insert(race.first);
+  }
+}
+
+void
+dpor::optimal_por()
+{
+  auto& ctx = *m_contexts[0];
+  optimal_init();
+  auto& opt = *m_optimal_ctx;
+
+  optimal_push_frame(m_start_state, process_set());
+  while (opt.m_depth > 0) {
+    int d = opt.m_depth - 1;
+    auto& f = opt.m_frames[d];
+    if (f.m_proc < 0) {
+      DPOR_COUNT(ctx, count_enabled_set_calls);
+      auto enabled = f.m_state->get_enabled_set();
+      if (enabled.empty()) {
+        ctx.m_executions++;
+        optimal_race_reversals();
+        optimal_pop_frame();
+        continue;
+      }
+      if (f.m_wut.empty()) {
+        enabled.set_difference(f.m_sleep);
+        if (enabled.empty()) {
+          DPOR_COUNT(ctx, count_sleep_prunes);
+          opt.m_sleep_blocked++;
+          optimal_pop_frame();
+          continue;
+        }
+        f.m_wut.add_child(0, enabled.first());
+      }
+    } else {
+      f.m_sleep.insert(f.m_proc);
+      f.m_wut.remove_first();
+    }
+    if (f.m_wut.empty()) {
+      optimal_pop_frame();
+      continue;
+    }
+
+    int child = f.m_wut.first_child(0);
+    int p = f.m_wut.get_proc(child);
+    f.m_proc = p;
+    int ins = opt.m_proc_instructions[p][f.m_state->get_pc(p)];
+    process_set sleep;
+    for (int q = f.m_sleep.first(); q >= 0; q = f.m_sleep.next(q)) {
+      auto const& list = opt.m_proc_instructions[q];
+      int pc = f.m_state->get_pc(q);
+      if (pc < (int) list.size() && !opt.m_hb_dependancy.test(ins, list[pc])) {
+        sleep.insert(q);
+      }
+    }
+
+    auto last_state = f.m_state;
+    state* next_state;
+    {
+      DPOR_TIME(ctx, time_next_state);
+      next_state = last_state->get_next_state(ins, ctx.m_arena);
+    }
+    next_state = find_state(ctx, next_state);
+    ctx.m_transitions++;
+    if (m_graph) {
+      m_graph->add_transition(last_state->get_label(), ins, next_state->get_label());
+    }
+    optimal_push_event(p, ins);
+    // the new frame may move the frames, f is not used below
+    optimal_push_frame(next_state, sleep);
+    opt.m_frames[d + 1].m_wut.assign_subtree(opt.m_frames[d].m_wut, child);
+    opt.m_frames[d].m_wut.make_leaf(child);
+  }
+}
@@ -0,0 +1,139 @@
+#include "dpor.hpp"
+#include <thread>
+#include <chrono>
+
+using namespace std;
+
+// Subtrees are only handed out while some worker is looking for work and
+// the current worker has nothing queued, so that stack copies stay rare
+bool
+dpor::should_spawn(explore_context& ctx)
+{
+  return m_num_threads > 1
+    && m_idle_workers.load(memory_order_relaxed) > 0
+    && m_deques[ctx.m_id]->empty();
+}
+
+// Queues the execution of proc at the state reached after the first
+// depth transitions of the stack of ctx
+void
+dpor::spawn_task(explore_context& ctx, int depth, int proc, process_set const& sleep)
+{
+  auto task = new explore_task();
+  task->m_prefix.assign(ctx.m_stack.begin(), ctx.m_stack.begin() + depth);
+  task->m_clocks = ctx.m_clocks;
+  task->m_frames.assign(ctx.m_frames.begin(), ctx.m_frames.begin() + depth + 1);
+  if (depth < (int) ctx.m_stack.size()) {
+    // process clocks as they were when the frame at depth was entered
+    task->m_clocks.rollback(ctx.m_frames[depth].m_clock_mark);
+  }
+  task->m_proc = proc;
+  task->m_sleep = sleep;
+
+  m_pending_tasks++;
+  m_spawned_tasks++;
+  m_deques[ctx.m_id]->push(task);
+}
+
+void
+dpor::run_task(explore_context& ctx, explore_task* task)
+{
+  ctx.m_stack.swap(task->m_prefix);
+  ctx.m_clocks = task->m_clocks;
+  ctx.m_frames.swap(task->m_frames);
+  ctx.m_base = ctx.m_stack.size();
+  for (int i = 0; i < ctx.m_base; ++i) {
+    push_access(ctx, i);
+  }
+
+  if (task->m_proc < 0) {
+    explore(ctx);
+  } else {
+    auto last_state = last_transition_sequence_state(ctx.m_stack);
+    detect_races(ctx, task->m_proc, last_state->get_next_instruction(task->m_proc), true);
+    push_transition(ctx, last_state, task->m_proc, task->m_sleep);
+    explore(ctx);
+  }
+
+  ctx.m_stack.clear();
+  ctx.m_accesses.clear();
+  ctx.m_frames.clear();
+  ctx.m_base = 0;
+}
+
+explore_task*
+dpor::steal_task(int thief)
+{
+  for (int i = 1; i < m_num_threads; ++i) {
+    auto task = m_deques[(thief + i) % m_num_threads]->steal();
+    if (task != NULL) {
+      m_stolen_tasks++;
+      return task;
+    }
+  }
+  return NULL;
+}
+
+void
+dpor::run_worker(int id)
+{
+  auto& ctx = *m_contexts[id];
+  bool idle = false;
+  int misses = 0;
+
+  while (true) {
+    auto task = m_deques[id]->pop();
+    if (task == NULL) {
+      task = steal_task(id);
+    }
+    if (task == NULL) {
+      if (!idle) {
+        idle = true;
+        m_idle_workers++;
+      }
+      if (m_pending_tasks.load() == 0) {
+        break;
+      }
+      if (++misses < 64) {
+        this_thread::yield();
+      } else {
+        this_thread::sleep_for(chrono::microseconds(50));
+      }
+      continue;
+    }
+    if (idle) {
+      idle = false;
+      m_idle_workers--;
+    }
+    misses = 0;
+    run_task(ctx, task);
+    delete task;
+    m_pending_tasks--;
+  }
+}
+
+// Work-stealing exploration. Every worker runs the sequential algorithm on
+// its own stack; subtrees rooted at backtrack points are queued as tasks
+// when other workers are idle, and the visited-state store and the sets on
+// each state are shared between workers.
+void
+dpor::parallel_por()
+{
+  for (int i = 0; i < m_num_threads; ++i) {
+    m_deques.emplace_back(new work_deque<explore_task>());
+  }
+
+  auto root = new explore_task();
+  root->m_clocks = clock_vectors(m_data->get_symbols().num_processes());
+  root->m_proc = -1;
+  m_pending_tasks++;
+  m_deques[0]->push(root);
+
+  vector<thread> workers;
+  for (int i = 0; i < m_num_threads; ++i) {
+    workers.emplace_back(&dpor::run_worker, this, i);
+  }
+  for (auto& t : workers) {
+    t.join();
+  }
+}
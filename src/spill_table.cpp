@@ -0,0 +1,210 @@
+#include "spill_table.hpp"
+#include "dpor.hpp"
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+static const size_t initial_spill_bytes = 64 << 20;
+
+spill_table::spill_table(size_t record_size)
+  : m_fd(-1), m_map(NULL), m_mapped(0), m_record_size(record_size)
+{
+  char const* dir = getenv("TMPDIR");
+  string name = string(dir && *dir ? dir : "/tmp") + "/dpor-spill-XXXXXX";
+  vector<char> path(name.begin(), name.end());
+  path.push_back('\0');
+  m_fd = mkstemp(path.data());
+  if (m_fd < 0) {
+    throw "Cannot create the spill file";
+  }
+  unlink(path.data());
+  grow(initial_spill_bytes);
+}
+
+spill_table::~spill_table()
+{
+  if (m_map) {
+    munmap(m_map, m_mapped);
+  }
+  if (m_fd >= 0) {
+    close(m_fd);
+  }
+}
+
+// Maps at least bytes bytes of the file
+void
+spill_table::grow(size_t bytes)
+{
+  size_t size = max(initial_spill_bytes, m_mapped);
+  while (size < bytes) {
+    size *= 2;
+  }
+  if (m_map) {
+    munmap(m_map, m_mapped);
+    m_map = NULL;
+  }
+  if (ftruncate(m_fd, size) != 0) {
+    throw "Cannot grow the spill file";
+  }
+  void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (map == MAP_FAILED) {
+    throw "Cannot map the spill file";
+  }
+  m_map = (char*) map;
+  m_mapped = size;
+}
+
+void
+spill_table::put(long index, void const* record)
+{
+  if ((index + 1) * m_record_size > m_mapped) {
+    grow((index + 1) * m_record_size);
+  }
+  memcpy(m_map + index * m_record_size, record, m_record_size);
+}
+
+fingerprint_index::fingerprint_index()
+  : m_entries(1024, 0), m_mask(1023), m_size(0), m_lookups(0), m_probes(0),
+    m_max_probe(0), m_collisions(0)
+{ }
+
+// Record of a spilled state: its slots, padded to 8 bytes, then its
+// backtrack, done and sleep sets as num_set_words() words each
+size_t
+dpor::spill_record_size() const
+{
+  size_t slots = (m_data->get_symbols().width() * sizeof(int) + 7) / 8 * 8;
+  return slots + 3 * num_set_words() * sizeof(uint64_t);
+}
+
+int const*
+dpor::spilled_slots(int label)
+{
+  m_spill_lookups++;
+  return (int const*) m_spill->at(label);
+}
+
+// Hash the visited states are indexed by
+size_t
+dpor::stored_hash(int label)
+{
+  state* s = m_spill_states[label];
+  int const* slots = s ? s->get_slots() : (int const*) m_spill->at(label);
+  if (m_symmetry) {
+    return m_symmetry->hash(slots);
+  }
+  return s ? s->hash() : state::compute_hash(slots, m_data->get_symbols().width());
+}
+
+// Memory taken by the index of the visited states, their labels and the
+// queue of the resident ones
+size_t
+dpor::spill_index_bytes() const
+{
+  return m_spill_index.bytes() + m_spill_states.capacity() * sizeof(state*)
+    + m_spill_queue.size() * sizeof(int);
+}
+
+// Spills stored states that are not on the stack of ctx, oldest first,
+// until the resident ones and the index are back under 7/8 of the memory
+// limit. Only called between two lookups, when every state referenced by
+// the search is on the stack.
+void
+dpor::spill_states(explore_context& ctx)
+{
+  long budget = max(m_mem_limit - (long) spill_index_bytes(), 0L);
+  long target = budget / ctx.m_arena.record_size() * 7 / 8;
+  vector<int> on_stack;
+  for (auto const& f : ctx.m_frames) {
+    on_stack.push_back(f.m_state->get_label());
+  }
+  sort(on_stack.begin(), on_stack.end());
+
+  size_t slot_bytes = m_data->get_symbols().width() * sizeof(int);
+  size_t set_offset = (slot_bytes + 7) / 8 * 8;
+  int words = num_set_words();
+  m_spill_buffer.assign(m_spill->record_size(), 0);
+  // states on the stack go to the back of the queue, give up after a
+  // full round in case everything is on the stack
+  for (size_t scanned = 0, n = m_spill_queue.size(); scanned < n && m_resident > target; ++scanned) {
+    int label = m_spill_queue.front();
+    m_spill_queue.pop_front();
+    state* s = m_spill_states[label];
+    if (binary_search(on_stack.begin(), on_stack.end(), label)) {
+      m_spill_queue.push_back(label);
+      continue;
+    }
+    memcpy(m_spill_buffer.data(), s->get_slots(), slot_bytes);
+    uint64_t* w = (uint64_t*) (m_spill_buffer.data() + set_offset);
+    for (int i = 0; i < words; ++i) {
+      w[i] = s->get_backtrack_set().get_word(i);
+      w[words + i] = s->get_done_set().get_word(i);
+      w[2 * words + i] = s->get_sleep_set().get_word(i);
+    }
+    m_spill->put(label, m_spill_buffer.data());
+    m_spill_states[label] = NULL;
+    ctx.m_arena.free(s);
+    m_resident--;
+  }
+}
+
+// Reads the spilled state at label back into memory
+state*
+dpor::unspill_state(explore_context& ctx, int label)
+{
+  auto const* record = (char const*) m_spill->at(label);
+  state* s = state::from_slots(m_data->get_symbols(), ctx.m_arena, (int const*) record);
+  size_t set_offset = (m_data->get_symbols().width() * sizeof(int) + 7) / 8 * 8;
+  uint64_t const* w = (uint64_t const*) (record + set_offset);
+  int words = num_set_words();
+  process_set backtrack, done, sleep;
+  for (int i = 0; i < words; ++i) {
+    backtrack.set_word(i, w[i]);
+    done.set_word(i, w[words + i]);
+    sleep.set_word(i, w[2 * words + i]);
+  }
+  s->set_backtrack_set(backtrack);
+  s->set_done_set(done);
+  s->set_sleep_set(sleep);
+  s->set_label(label);
+  m_spill_states[label] = s;
+  m_spill_queue.push_back(label);
+  m_resident++;
+  m_spill_faults++;
+  return s;
+}
+
+// Looks s up like find_state, comparing it with spilled states on disk
+// when their fingerprint matches, and appends it if it is new. Spills
+// first if over the memory limit.
+state*
+dpor::find_or_unspill(explore_context& ctx, state* s)
+{
+  if (m_resident * (long) ctx.m_arena.record_size() + (long) spill_index_bytes() > m_mem_limit) {
+    spill_states(ctx);
+  }
+  size_t width = m_data->get_symbols().width();
+  size_t h = m_symmetry ? m_symmetry->hash(s->get_slots()) : s->hash();
+  // s takes the next label while the index may grow, and gives it back
+  // if it was visited
+  int n = m_spill_states.size();
+  m_spill_states.push_back(s);
+  int i = m_spill_index.find_or_insert(h, [&](int i) {
+    state* candidate = m_spill_states[i];
+    int const* slots = candidate ? candidate->get_slots() : spilled_slots(i);
+    if (m_symmetry) {
+      return m_symmetry->equivalent(slots);
+    }
+    return memcmp(slots, s->get_slots(), width * sizeof(int)) == 0;
+  }, [this](int label) { return stored_hash(label); });
+  if (i < n) {
+    m_spill_states.pop_back();
+  } else {
+    m_spill_queue.push_back(i);
+  }
+  state* found = m_spill_states[i];
+  return found ? found : unspill_state(ctx, i);
+}
@@ -0,0 +1,71 @@
+#include "state_arena.hpp"
+#include "dpor.hpp"
+#include <new>
+
+using namespace std;
+
+static const size_t slab_bytes = 1 << 20;
+
+state_arena::state_arena()
+  : m_symbols(NULL), m_record_size(0), m_records_per_slab(0),
+    m_used(0), m_allocated(0), m_recycled(0)
+{ }
+
+state_arena::state_arena(symbol_table const* symbols)
+  : m_symbols(symbols), m_used(0), m_allocated(0), m_recycled(0)
+{
+  size_t align = alignof(state);
+  size_t size = sizeof(state) + symbols->width() * sizeof(int);
+  m_record_size = (size + align - 1) / align * align;
+  m_records_per_slab = max((size_t) 1, slab_bytes / m_record_size);
+  m_used = m_records_per_slab;
+}
+
+state_arena::~state_arena()
+{
+  release();
+}
+
+state*
+state_arena::allocate()
+{
+  assert(m_symbols);
+  m_allocated++;
+  if (m_free.size()) {
+    state* ret = m_free.back();
+    m_free.pop_back();
+    m_recycled++;
+    return ret;
+  }
+
+  if (m_used == m_records_per_slab) {
+    m_slabs.push_back(new char[m_records_per_slab * m_record_size]);
+    m_used = 0;
+  }
+  char* record = m_slabs.back() + m_used * m_record_size;
+  m_used++;
+  int* slots = reinterpret_cast<int*>(record + sizeof(state));
+  return new (record) state(m_symbols, slots);
+}
+
+void
+state_arena::free(state* s)
+{
+  s->clear_sets();
+  m_free.push_back(s);
+}
+
+void
+state_arena::release()
+{
+  for (size_t i = 0; i < m_slabs.size(); ++i) {
+    size_t n = (i + 1 == m_slabs.size()) ? m_used : m_records_per_slab;
+    for (size_t j = 0; j < n; ++j) {
+      reinterpret_cast<state*>(m_slabs[i] + j * m_record_size)->~state();
+    }
+    delete[] m_slabs[i];
+  }
+  m_slabs.clear();
+  m_free.clear();
+  m_used = m_records_per_slab;
+}
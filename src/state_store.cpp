@@ -0,0 +1,96 @@
+#include "state_store.hpp"
+#include "dpor.hpp"
+
+using namespace std;
+
+static const size_t initial_capacity = 1024;
+
+state_store::state_store()
+  : m_hashes(initial_capacity, 0), m_slots(initial_capacity, -1),
+    m_mask(initial_capacity - 1), m_lookups(0), m_probes(0),
+    m_max_probe(0), m_collisions(0)
+{ }
+
+void
+state_store::grow()
+{
+  size_t capacity = m_slots.size() * 2;
+  vector<size_t> hashes(capacity, 0);
+  vector<int> slots(capacity, -1);
+  size_t mask = capacity - 1;
+
+  for (size_t i = 0; i < m_slots.size(); ++i) {
+    if (m_slots[i] < 0) {
+      continue;
+    }
+    size_t pos = m_hashes[i] & mask;
+    while (slots[pos] >= 0) {
+      pos = (pos + 1) & mask;
+    }
+    hashes[pos] = m_hashes[i];
+    slots[pos] = m_slots[i];
+  }
+
+  m_hashes.swap(hashes);
+  m_slots.swap(slots);
+  m_mask = mask;
+}
+
+state*
+state_store::find_or_insert(state* const& s)
+{
+  return find_or_insert(s, s->hash());
+}
+
+state*
+state_store::find_or_insert(state* const& s, size_t h)
+{
+  return find_or_insert(s, h, [&s](state* candidate) { return *candidate == *s; });
+}
+
+state*
+concurrent_state_store::find_or_insert(state* const& s)
+{
+  size_t h = s->hash();
+  // the low bits pick the slot inside a shard, so use the high ones here
+  size_t shard = (h >> 48) % m_shards.size();
+  lock_guard<std::mutex> lock(m_locks[shard]);
+  state* found = m_shards[shard].find_or_insert(s, h);
+  if (found == s) {
+    s->set_label(m_next_label++);
+  }
+  return found;
+}
+
+long
+concurrent_state_store::probes() const
+{
+  long probes = 0;
+  for (auto const& shard : m_shards) {
+    probes += shard.probes();
+  }
+  return probes;
+}
+
+string
+concurrent_state_store::dump_stats() const
+{
+  size_t capacity = 0;
+  long lookups = 0, probes = 0, max_probe = 0, collisions = 0;
+  for (auto const& shard : m_shards) {
+    capacity += shard.capacity();
+    lookups += shard.lookups();
+    probes += shard.probes();
+    max_probe = max(max_probe, shard.max_probe());
+    collisions += shard.collisions();
+  }
+
+  stringstream ss;
+  ss << "STATE_INDEX_SHARDS = " << m_shards.size() << "\n";
+  ss << "STATE_INDEX_CAPACITY = " << capacity << "\n";
+  ss << "STATE_INDEX_LOOKUPS = " << lookups << "\n";
+  ss << "STATE_INDEX_AVG_PROBE = " << (lookups ? (double) probes / lookups : 0.0) << "\n";
+  ss << "STATE_INDEX_MAX_PROBE = " << max_probe << "\n";
+  ss << "STATE_INDEX_HASH_COLLISIONS = " << collisions << "\n";
+  return ss.str();
+}
@@ -0,0 +1,146 @@
+#include "symmetry.hpp"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+
+// Whether swapping processes p and q is an automorphism of the program:
+// their instructions match position by position, and the dependancy
+// relation is the same after renaming the instructions of p to those of q
+// and back
+static bool
+are_symmetric(concurrent_procs const& program, int p, int q)
+{
+  auto const& table = program.get_symbols().get_table();
+  int n = table.size();
+  int length = 0;
+  while (table.at(p, length) >= 0) {
+    length++;
+  }
+  if (length == 0 || table.at(q, length - 1) < 0 || table.at(q, length) >= 0) {
+    return false;
+  }
+  for (int i = 0; i < length; ++i) {
+    int a = table.at(p, i), b = table.at(q, i);
+    if (table.get_opcode(a) != table.get_opcode(b)
+      || table.get_operand(a) != table.get_operand(b)
+      || table.get_source(a) != table.get_source(b)) {
+      return false;
+    }
+  }
+  int first_p = table.at(p, 0), first_q = table.at(q, 0);
+  // the image of instruction x under the swap
+  auto swap_ins = [&](int x) {
+    if (table.get_process(x) == p) {
+      return x - first_p + first_q;
+    }
+    if (table.get_process(x) == q) {
+      return x - first_q + first_p;
+    }
+    return x;
+  };
+  for (int i = 0; i < length; ++i) {
+    int a = table.at(p, i), b = table.at(q, i);
+    for (int x = 0; x < n; ++x) {
+      int y = swap_ins(x);
+      if (program.is_dependant(a, x) != program.is_dependant(b, y)
+        || program.is_dependant(x, a) != program.is_dependant(y, b)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+symmetry::symmetry(concurrent_procs const& program)
+  : m_symbols(&program.get_symbols())
+{
+  int num_procs = m_symbols->num_processes();
+  // the symmetry is an equivalence, so comparing with the first process
+  // of every class is enough
+  vector<vector<int>> classes;
+  for (int p = 0; p < num_procs; ++p) {
+    bool placed = false;
+    if (m_symbols->get_table().at(p, 0) >= 0) {
+      for (auto& c : classes) {
+        if (are_symmetric(program, c[0], p)) {
+          c.push_back(p);
+          placed = true;
+          break;
+        }
+      }
+    }
+    if (!placed) {
+      classes.push_back(vector<int>(1, p));
+    }
+  }
+  for (auto& c : classes) {
+    if (c.size() > 1) {
+      m_classes.push_back(c);
+    }
+  }
+  m_rename.resize(num_procs);
+  m_canonical.resize(m_symbols->width());
+  m_candidate.resize(m_symbols->width());
+}
+
+int
+symmetry::num_symmetric_processes() const
+{
+  int ret = 0;
+  for (auto const& c : m_classes) {
+    ret += c.size();
+  }
+  return ret;
+}
+
+void
+symmetry::canonicalize(int const* slots, int* out)
+{
+  auto const& symbols = *m_symbols;
+  memcpy(out, slots, symbols.width() * sizeof(int));
+  for (int p = 0; p < symbols.num_processes(); ++p) {
+    m_rename[p] = p;
+  }
+  for (auto const& c : m_classes) {
+    m_order.clear();
+    for (int p : c) {
+      m_order.push_back(make_pair(slots[symbols.pc_slot(p)], p));
+    }
+    sort(m_order.begin(), m_order.end());
+    for (size_t i = 0; i < c.size(); ++i) {
+      out[symbols.pc_slot(c[i])] = m_order[i].first;
+      m_rename[m_order[i].second] = c[i];
+    }
+  }
+  for (int m = 0; m < symbols.num_mutex_vars(); ++m) {
+    int& owner = out[symbols.mutex_slot(m)];
+    if (owner >= 0) {
+      owner = m_rename[owner];
+    }
+  }
+}
+
+size_t
+symmetry::hash(int const* slots)
+{
+  canonicalize(slots, m_canonical.data());
+  return hash_ints(m_canonical.data(), m_canonical.size());
+}
+
+bool
+symmetry::equivalent(int const* slots)
+{
+  canonicalize(slots, m_candidate.data());
+  return memcmp(m_candidate.data(), m_canonical.data(), m_canonical.size() * sizeof(int)) == 0;
+}
+
+string
+symmetry::dump_string() const
+{
+  stringstream ss;
+  ss << "SYMMETRY_CLASSES = " << m_classes.size() << "\n";
+  ss << "SYMMETRIC_PROCESSES = " << num_symmetric_processes() << "\n";
+  return ss.str();
+}
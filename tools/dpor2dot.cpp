@@ -0,0 +1,111 @@
+// Converts a binary graph written by `dpor --binary` to the DOT output of
+// a plain run. The edges are written in exploration order, and every state
+// of the state table just before the edge that first reaches it, so the
+// output of a single-threaded run is the same file.
+//
+//   dpor2dot <input.bin> <output.dot>
+
+#include "graph_format.hpp"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+int
+main(int argc, char **argv)
+{
+  if (argc < 3) {
+    cout << "Usage: " << argv[0] << " <input.bin> <output.dot>" << endl;
+    return 1;
+  }
+  int fd = open(argv[1], O_RDONLY);
+  if (fd < 0) {
+    cout << "Cannot open " << argv[1] << endl;
+    return 1;
+  }
+  struct stat st;
+  fstat(fd, &st);
+  size_t size = st.st_size;
+  if (size < sizeof(graph_file_header)) {
+    cout << "Not a graph file: " << argv[1] << endl;
+    return 1;
+  }
+  char const* data = (char const*) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED) {
+    cout << "Cannot map " << argv[1] << endl;
+    return 1;
+  }
+  close(fd);
+
+  graph_file_header const* header = (graph_file_header const*) data;
+  if (memcmp(header->m_magic, graph_file_magic, sizeof(graph_file_magic)) != 0
+      || header->m_version != graph_file_version) {
+    cout << "Not a graph file: " << argv[1] << endl;
+    return 1;
+  }
+  if (header->m_states_offset + header->m_num_states * sizeof(int32_t) > size) {
+    cout << "Truncated or unfinished graph file: " << argv[1] << endl;
+    return 1;
+  }
+
+  vector<string> actions;
+  char const* p = data + header->m_actions_offset;
+  for (uint32_t i = 0; i < header->m_num_actions; ++i) {
+    uint32_t length;
+    memcpy(&length, p, sizeof(length));
+    actions.emplace_back(p + sizeof(length), length);
+    p += sizeof(length) + (length + 3) / 4 * 4;
+  }
+  graph_edge const* edges = (graph_edge const*) (data + header->m_edges_offset);
+  int32_t const* states = (int32_t const*) (data + header->m_states_offset);
+
+  ofstream out(argv[2]);
+  string buffer;
+  buffer += "digraph{\n";
+  buffer += "\tnodesep = 0.5;\n";
+  buffer += "\tranksep = 0.35;\n";
+  // The table is in discovery order and a state is discovered right before
+  // the edge reaching it first, so walking it along the edges restores the
+  // order of the DOT output. States left over, e.g. when several threads
+  // interleave, come last.
+  uint64_t next_state = 0;
+  auto add_state = [&]() {
+    buffer += '\t';
+    buffer += to_string(states[next_state++]);
+    buffer += '\n';
+  };
+  if (header->m_num_states > 0) {
+    add_state();
+  }
+  for (uint64_t i = 0; i < header->m_num_edges; ++i) {
+    if (next_state < header->m_num_states && states[next_state] == edges[i].m_to) {
+      add_state();
+    }
+    buffer += '\t';
+    buffer += to_string(edges[i].m_from);
+    buffer += " -> ";
+    buffer += to_string(edges[i].m_to);
+    buffer += " [label=\"";
+    buffer += actions[edges[i].m_action];
+    buffer += "\"];\n";
+    if (buffer.size() >= (1 << 20)) {
+      out << buffer;
+      buffer.clear();
+    }
+  }
+  while (next_state < header->m_num_states) {
+    add_state();
+  }
+  buffer += "}";
+  out << buffer;
+  out.close();
+  munmap((void*) data, size);
+  return 0;
+}